@@ -29,29 +29,210 @@
  * This plugin will first load the complete program into memory before starting
  * the emulator and producing output.
  *
+ * Several tunes can be decoded back-to-back, e.g. from concat. Each
+ * stream-start on the sink pad completes the data of the previous tune,
+ * and playback starts with the first complete tune rather than at the
+ * final EOS. The next tune is played when the previous one ends, with
+ * continuous timestamps. Most SID tunes loop forever, so a tune ends by
+ * its song length database entry, max-length, silence-duration or
+ * max-loops; with none of them a tune followed by others ends after 3
+ * minutes.
+ *
  * To play RSID files: kernal, basic and possibly chargen ROM byte arrays should
  * be set. PSID files works without those.
  *
- * Seeking is not (and cannot be) implemented.
+ * Seeking in time is supported within the playing tune. A C64 program can
+ * not jump in time, so the emulation runs to the target without producing
+ * output: at 32 times the speed with fast-forward, and for the last second
+ * at normal speed to land exactly on the target sample. Seeking forward
+ * continues from the current position, seeking backward restarts the
+ * tune. The progress is posted as buffering messages. The cost of a seek
+ * thus grows with the distance, a seek minutes ahead takes a moment.
+ *
+ * With seek-history set, the last rendered audio is kept in memory, raw,
+ * for that long. Seeks into it, typically rewinding a few seconds, are
+ * then served from memory at once, and the emulation continues where it
+ * was when the history is played out. The history is only kept while
+ * playing at normal rate.
+ *
+ * Seeks with a rate between 1.0 and 32.0 play the tune faster, for cueing
+ * and previews. The emulation itself runs faster through sidplayfp's
+ * fast-forward, the output stays at normal speed and the segment carries
+ * the rate as applied rate. sidplayfp only fast-forwards by whole factors,
+ * so rates are rounded to the nearest integer. Seeks with the
+ * instant-rate-change flag are passed on downstream as an
+ * instant-rate-change event instead: the emulation and the segment stay
+ * as they are and the sink plays the audio at the new rate, which may
+ * then also be below 1.0 or fractional.
+ *
+ * Properties may be changed while playing. The changes are collected and
+ * applied together before the next block. Filter settings and blocksize
+ * change seamlessly, changing the C64, SID or CIA model, the sampling
+ * method or digi boost restarts the tune. The emulation, tune and ROMs are
+ * used from the next tune on.
+ *
+ * With emulation=null no SID chip is emulated at all. The C64 still runs
+ * the tune, but the element outputs silence sized by the emulated time, at
+ * a large multiple of realtime. This is meant for scanning tunes, e.g. for
+ * their length, without listening to them. As there is no sound to look
+ * at, silence-duration and skip-leading-silence have no effect then.
+ * Tunes end by the song length database, max-length or when the player
+ * stops.
+ *
+ * emulation=preview is meant for browsing and scrubbing through many tunes.
+ * It uses ReSID with fast sampling and no interpolation, which sounds
+ * rough (aliasing) and should need less CPU time than the default
+ * emulation, though how much less has not been measured. The filter is
+ * off in every emulation of this element, so it is not a difference. The
+ * cost model calibrates its guess for preview while playing, see the cost
+ * property.
+ *
+ * The register-log property records the SID registers into a file while
+ * decoding, see gstsidreglog.h for the format. libsidplayfp can not report
+ * single writes, so the log is the difference between snapshots of the
+ * registers taken once per frame of the emulated C64, which is how often
+ * most players update them. Writes in between, like the fast waveform and
+ * pulse changes of digis and some drum sounds, are lost, so a log is not
+ * an exact recording of the tune. This needs libsidplayfp 2.2 or newer
+ * and a real SID emulation.
+ *
+ * Every tune file publishes a TOC with one entry per subtune, with the
+ * uids "tune-1" to "tune-N" and the lengths from the song length database
+ * when known. As each subtune starts over, all entries start at 0. A
+ * TOC select event, or a seek in the "subtune" format with the subtune as
+ * start position, switches to another subtune on the running engine
+ * without renegotiating. The subtune format can also be used in position,
+ * duration and seeking queries.
+ *
+ * With all-subtunes set the element plays every subtune of the file, from
+ * the first to the last, as one continuous stream, e.g. for archiving
+ * whole files. Tags are updated with every subtune and the TOC entries
+ * then carry the positions of the subtunes in the stream. Subtune seeks
+ * jump to the start of the subtune in the stream, time seeks stay within
+ * the current subtune. Set max-length to end subtunes whose length is not
+ * known otherwise. With skip-leading-silence the positions of subtunes not
+ * played yet are unknown, as their skipped lead-ins are.
+ *
+ * For indexing and transcoding, src_%u request pads render the subtunes
+ * of a file in parallel: pad src_N plays subtune N from its start, on an
+ * own engine from the pool and on an own thread, while all engines share
+ * the parsed tune. A file thus renders in about the time of its longest
+ * subtune. The pads negotiate on their own, render the tune that plays
+ * when they start and end with their subtune, by the song length
+ * database, max-length, silence-duration or the player stopping. They
+ * can not seek. The src pad may stay unlinked when only they are used.
+ *
+ * The songlength-db property points to a song length database in the
+ * HVSC Songlengths.md5 format. Tunes found in it report their duration
+ * and end at the listed length, otherwise they play until they stop by
+ * themselves, which many never do. The database is compiled into a binary
+ * index in the user cache directory the first time it is used and shared
+ * by all elements of the process.
+ *
+ * Many tunes end in silence, or jam the emulated CPU, which then keeps
+ * the chips silent forever. With silence-duration set, a tune ends after
+ * its output stayed within silence-threshold for that long. A tune also
+ * ends when the player renders less than asked for, which it only does
+ * when it stopped. Either way playback continues with the next queued
+ * tune, or ends with EOS. A tune that does none of this plays forever,
+ * also with more tunes queued after it, so playlists of tunes without a
+ * known length need max-length, silence-duration or max-loops to get to
+ * the next one.
+ *
+ * Tunes often take a while to initialize before making a sound, RSIDs
+ * that boot through BASIC even seconds. skip-leading-silence runs each
+ * tune at full fast-forward until its output exceeds silence-threshold or
+ * a note is started on a chip, and starts the output there. Timestamps
+ * then count from the first sound.
+ *
+ * For tunes without a known length, loop-detection watches the SID
+ * registers for the tune starting over, see gstsidloop.h. The loop point
+ * and period are posted as a "siddecfp-loop" element message with the
+ * fields "tune", "start" and "period", both times counted from the start
+ * of the tune. With max-loops set the tune then ends after that many
+ * periods, which gives playlists an end even for endless tunes. As the
+ * registers are needed this does not work with emulation=null, use
+ * emulation=preview to find loops quickly. Loops are only searched for
+ * while playing at normal rate.
+ *
+ * For A/B comparisons the ab-sid-model property renders the same run of
+ * the tune a second time with another SID model. The output is then
+ * stereo, the left channel is the normal mono output and the right one
+ * the alternative. The alternative runs on a second sidplayfp engine with
+ * the same emulation and the SID model forced, kept in step with the
+ * first one, so it costs as much CPU again. It needs a SID emulation and
+ * a downstream that accepts two channels, otherwise the output stays as
+ * it is.
+ *
+ * Tunes for two or three SID chips are rendered ahead on a separate
+ * thread that keeps up to render-ahead blocks buffered, so a short stall
+ * of the emulation or of the downstream elements does not interrupt the
+ * audio. This is buffering only: all chips of a tune are still emulated
+ * on the one thread, so a tune that can not be emulated in realtime on
+ * one core does not play in realtime with it either. The chips can not
+ * be clocked on threads of their own: libsidplayfp keeps its SID
+ * emulations internal to the emulated C64, which clocks them in step
+ * with the CPU, and players read back chip state like OSC3 and ENV3.
+ * Single SID tunes render on the streaming thread.
+ *
+ * The render ahead thread can be pinned to CPUs with cpu-affinity, given
+ * a realtime scheduling-policy and a thread-name. Setting any of them
+ * renders single SID tunes on that thread too, as the streaming thread
+ * comes from a pool shared with other elements and is left as it is. The
+ * settings are applied when the thread starts and need render-ahead to be
+ * above 0. Realtime scheduling usually needs privileges (CAP_SYS_NICE or
+ * an rtprio limit), failures are posted as warnings and playback
+ * continues. Shared scheduler threads are not tuned either.
+ *
+ * Decoders reserve their estimated CPU cost from a process wide budget
+ * when they start playing, see the cost property and gstsiddecfppool.cc.
+ * The over-budget property decides what happens when a tune does not fit:
+ * play it anyway, refuse it with an error, or downgrade to cheaper
+ * emulations (ReSID, then preview) until it fits. Each subtune pad is
+ * admitted the same way when it starts, with its own output format. The
+ * cost property only covers the element's own player.
+ *
+ * With many decoders in one process, shared-scheduler renders all tunes on
+ * a fixed number of process wide threads instead, see gstsiddecfppool.cc.
+ * The decoder whose rendered audio runs out first is served first, and
+ * the streaming threads only push the rendered buffers.
+ *
+ * The sidplayfp engines are shared by all siddecfp elements of a process
+ * through a pool, see the engine-pool-stats property. The environment
+ * variables GST_SIDDECFP_POOL_SIZE (unbounded by default),
+ * GST_SIDDECFP_POOL_WARMUP and GST_SIDDECFP_POOL_TIMEOUT (in milliseconds)
+ * configure it. With a size set, going to READY fails at once when no
+ * engine is free, it does not wait for one.
  *
  * ## Example pipelines
  *
  * |[
  * gst-launch-1.0 -v filesrc location=Delta.sid ! siddecfp ! audioconvert ! audioresample ! autoaudiosink
  * ]| Decode a sid file and play it back.
+ * |[
+ * gst-launch-1.0 filesrc location=Commando.sid ! siddecfp name=d songlength-db=Songlengths.md5 \
+ *     d.src_1 ! queue ! wavenc ! filesink location=1.wav \
+ *     d.src_2 ! queue ! wavenc ! filesink location=2.wav
+ * ]| Render the first two subtunes to WAV files at the same time.
  */
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
 
-#include <sidplayfp/builders/resid.h>
-#include <sidplayfp/builders/residfp.h>
 #include <sidplayfp/SidTuneInfo.h>
 
+#include <errno.h>
+#include <stdio.h>
 #include <string.h>
 #include <gst/audio/audio.h>
+#if defined (HAVE_PTHREAD_SETAFFINITY_NP) || \
+    defined (HAVE_PTHREAD_SETNAME_NP) || defined (HAVE_PTHREAD_SETSCHEDPARAM)
+#include <pthread.h>
+#include <sched.h>
+#endif
 #include "gstsiddecfp.h"
+#include "gstsiddecfppool.h"
 
 #define DEFAULT_EMULATION SIDDECFP_EMULATION_RESIDFP
 #define DEFAULT_TUNE 0
@@ -67,9 +248,46 @@
 #define DEFAULT_FILTER_CURVE_8580 0.5
 #define DEFAULT_FILTER_BIAS 0.5
 #define DEFAULT_BLOCKSIZE 4096
+#define DEFAULT_RENDER_AHEAD 4
+#define DEFAULT_SHARED_SCHEDULER FALSE
+#define DEFAULT_OVER_BUDGET SIDDECFP_OVER_BUDGET_PLAY
+#define DEFAULT_SCHEDULING_POLICY SIDDECFP_SCHED_OTHER
+#define DEFAULT_SCHEDULING_PRIORITY 0
+#define DEFAULT_SEEK_HISTORY 0
+#define DEFAULT_ALL_SUBTUNES FALSE
+#define DEFAULT_MAX_LENGTH 0
+#define DEFAULT_SKIP_LEADING_SILENCE FALSE
+#define DEFAULT_SILENCE_THRESHOLD 16
+#define DEFAULT_SILENCE_DURATION 0
+#define DEFAULT_LOOP_DETECTION FALSE
+#define DEFAULT_MAX_LOOPS 0
+
+/* rendered audio after which the cost model is calibrated */
+#define CALIBRATION_TIME GST_SECOND
 
 #define MAX_SID_TUNE_BUF_SIZE (8*DEFAULT_BLOCKSIZE) /* more than enough */
 
+/* samples per play() call while seeking, and the fast-forward speed in
+ * percent until SEEK_EXACT_MS before the target */
+#define SEEK_CHUNK 1024
+#define SEEK_FAST_FORWARD 3200
+#define SEEK_EXACT_MS 1000
+
+/* skipping leading silence, chunks of frames to check and the longest
+ * silence to skip */
+#define LEAD_IN_CHUNK 64
+#define MAX_LEAD_IN_MS 30000
+
+/* fast-forward limits of sidplayfp, 100% to 3200%, in whole factors */
+#define MIN_RATE 1.0
+#define MAX_RATE 32.0
+#define ROUND_RATE(rate) ((gdouble) (gint) ((rate) + 0.5))
+
+/* frames of register states compared when looking for loops, 10 seconds,
+ * and how many of them at least have to differ from the frame before */
+#define LOOP_WINDOW_FRAMES 500
+#define LOOP_MIN_CHANGES 25
+
 
 enum
 {
@@ -92,7 +310,27 @@ enum
   PROP_BASIC,
   PROP_CHARGEN,
   PROP_BLOCKSIZE,
-  PROP_METADATA
+  PROP_METADATA,
+  PROP_REGISTER_LOG,
+  PROP_AB_SID_MODEL,
+  PROP_ENGINE_POOL_STATS,
+  PROP_RENDER_AHEAD,
+  PROP_SHARED_SCHEDULER,
+  PROP_OVER_BUDGET,
+  PROP_COST,
+  PROP_CPU_AFFINITY,
+  PROP_SCHEDULING_POLICY,
+  PROP_SCHEDULING_PRIORITY,
+  PROP_THREAD_NAME,
+  PROP_SONGLENGTH_DB,
+  PROP_SEEK_HISTORY,
+  PROP_ALL_SUBTUNES,
+  PROP_MAX_LENGTH,
+  PROP_SKIP_LEADING_SILENCE,
+  PROP_SILENCE_THRESHOLD,
+  PROP_SILENCE_DURATION,
+  PROP_LOOP_DETECTION,
+  PROP_MAX_LOOPS
 };
 
 static GstStaticPadTemplate sink_templ = GST_STATIC_PAD_TEMPLATE ("sink",
@@ -103,16 +341,26 @@ static GstStaticPadTemplate sink_templ = GST_STATIC_PAD_TEMPLATE ("sink",
 
 #define FORMATS "{ " GST_AUDIO_NE(S16) " }"
 
+#define SRC_CAPS \
+    "audio/x-raw, " \
+    "format = (string) " FORMATS ", " \
+    "layout = (string) interleaved, " \
+    "rate = (int) [ 8000, 48000 ], " "channels = (int) [ 1, 2 ]"
+
 static GstStaticPadTemplate src_templ = GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_SRC,
     GST_PAD_ALWAYS,
-    GST_STATIC_CAPS ("audio/x-raw, "
-      "format = (string) " FORMATS ", "
-      "layout = (string) interleaved, "
-      "rate = (int) [ 8000, 48000 ], " "channels = (int) [ 1, 2 ]")
+    GST_STATIC_CAPS (SRC_CAPS)
+    );
+
+static GstStaticPadTemplate subtune_src_templ =
+GST_STATIC_PAD_TEMPLATE ("src_%u",
+    GST_PAD_SRC,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (SRC_CAPS)
     );
 
-GST_DEBUG_CATEGORY_STATIC (gst_siddecfp_debug);
+GST_DEBUG_CATEGORY (gst_siddecfp_debug);
 #define GST_CAT_DEFAULT gst_siddecfp_debug
 
 #define GST_TYPE_EMULATION (gst_emulation_get_type())
@@ -123,6 +371,8 @@ gst_emulation_get_type (void)
   static const GEnumValue emulation[] = {
     {SIDDECFP_EMULATION_RESIDFP, "RESIDFP", "residfp"},
     {SIDDECFP_EMULATION_RESID, "RESID", "resid"},
+    {SIDDECFP_EMULATION_NULL, "NULL", "null"},
+    {SIDDECFP_EMULATION_PREVIEW, "PREVIEW", "preview"},
     {0, NULL, NULL},
   };
 
@@ -132,6 +382,60 @@ gst_emulation_get_type (void)
   return emulation_type;
 }
 
+#define GST_TYPE_SCHEDULING_POLICY (gst_scheduling_policy_get_type())
+static GType
+gst_scheduling_policy_get_type (void)
+{
+  static GType scheduling_policy_type = 0;
+  static const GEnumValue scheduling_policy[] = {
+    {SIDDECFP_SCHED_OTHER, "OTHER", "other"},
+    {SIDDECFP_SCHED_FIFO, "FIFO", "fifo"},
+    {SIDDECFP_SCHED_RR, "RR", "rr"},
+    {0, NULL, NULL},
+  };
+
+  if (!scheduling_policy_type) {
+    scheduling_policy_type = g_enum_register_static ("GstSidDecFpSchedulingPolicy", scheduling_policy);
+  }
+  return scheduling_policy_type;
+}
+
+#define GST_TYPE_OVER_BUDGET (gst_over_budget_get_type())
+static GType
+gst_over_budget_get_type (void)
+{
+  static GType over_budget_type = 0;
+  static const GEnumValue over_budget[] = {
+    {SIDDECFP_OVER_BUDGET_PLAY, "PLAY", "play"},
+    {SIDDECFP_OVER_BUDGET_REFUSE, "REFUSE", "refuse"},
+    {SIDDECFP_OVER_BUDGET_DOWNGRADE, "DOWNGRADE", "downgrade"},
+    {0, NULL, NULL},
+  };
+
+  if (!over_budget_type) {
+    over_budget_type = g_enum_register_static ("GstSidDecFpOverBudget", over_budget);
+  }
+  return over_budget_type;
+}
+
+#define GST_TYPE_AB_SID_MODEL (gst_ab_sid_model_get_type())
+static GType
+gst_ab_sid_model_get_type (void)
+{
+  static GType ab_sid_model_type = 0;
+  static const GEnumValue ab_sid_model[] = {
+    {SIDDECFP_AB_NONE, "NONE", "none"},
+    {SIDDECFP_AB_MOS6581, "MOS6581", "mos6581"},
+    {SIDDECFP_AB_MOS8580, "MOS8580", "mos8580"},
+    {0, NULL, NULL},
+  };
+
+  if (!ab_sid_model_type) {
+    ab_sid_model_type = g_enum_register_static ("GstSidDecFpAbSidModel", ab_sid_model);
+  }
+  return ab_sid_model_type;
+}
+
 #define GST_TYPE_SID_MODEL (gst_sid_model_get_type())
 static GType
 gst_sid_model_get_type (void)
@@ -207,11 +511,25 @@ gst_cia_model_get_type (void)
 
 static void gst_siddecfp_finalize (GObject * object);
 
+static GstStateChangeReturn gst_siddecfp_change_state (GstElement * element,
+    GstStateChange transition);
+
 static GstFlowReturn gst_siddecfp_chain (GstPad * pad, GstObject * parent,
     GstBuffer * buffer);
 static gboolean gst_siddecfp_sink_event (GstPad * pad, GstObject * parent,
     GstEvent * event);
 
+static gboolean play_next_tune (GstSidDecFp * siddecfp);
+static void stop_render_ahead (GstSidDecFp * siddecfp, GQueue * rendered);
+static void reset_loop_detection (GstSidDecFp * siddecfp);
+static void song_loaded (GstSidDecFp * siddecfp);
+static void stop_subtune_pads (GstSidDecFp * siddecfp);
+static void clear_history (GstSidDecFp * siddecfp);
+
+static GstPad *gst_siddecfp_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * name, const GstCaps * caps);
+static void gst_siddecfp_release_pad (GstElement * element, GstPad * pad);
+
 static gboolean gst_siddecfp_src_convert (GstPad * pad, GstFormat src_format,
     gint64 src_value, GstFormat * dest_format, gint64 * dest_value);
 static gboolean gst_siddecfp_src_event (GstPad * pad, GstObject * parent,
@@ -227,6 +545,9 @@ static void gst_siddecfp_set_property (GObject * object, guint prop_id,
 #define gst_siddecfp_parent_class parent_class
 G_DEFINE_TYPE (GstSidDecFp, gst_siddecfp, GST_TYPE_ELEMENT);
 
+/* seeks and queries by subtune, counting from 1 */
+static GstFormat subtune_format;
+
 static void
 gst_siddecfp_class_init (GstSidDecFpClass * klass)
 {
@@ -240,6 +561,12 @@ gst_siddecfp_class_init (GstSidDecFpClass * klass)
   gobject_class->set_property = gst_siddecfp_set_property;
   gobject_class->get_property = gst_siddecfp_get_property;
 
+  gstelement_class->change_state = gst_siddecfp_change_state;
+  gstelement_class->request_new_pad = gst_siddecfp_request_new_pad;
+  gstelement_class->release_pad = gst_siddecfp_release_pad;
+
+  subtune_format = gst_format_register ("subtune", "SID subtune");
+
   g_object_class_install_property (G_OBJECT_CLASS (klass), PROP_EMULATION,
       g_param_spec_enum ("emulation", "Emulation", "Select libsidplayfp emulation",
           GST_TYPE_EMULATION, DEFAULT_EMULATION,
@@ -320,12 +647,120 @@ gst_siddecfp_class_init (GstSidDecFpClass * klass)
   g_object_class_install_property (gobject_class, PROP_METADATA,
       g_param_spec_boxed ("metadata", "Metadata", "Metadata", GST_TYPE_CAPS,
           (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_REGISTER_LOG,
+      g_param_spec_string ("register-log", "Register log",
+          "File to record the changes of per frame SID register snapshots "
+          "to, writes within a frame are lost (NULL = disabled)", NULL,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_AB_SID_MODEL,
+      g_param_spec_enum ("ab-sid-model", "A/B SID model",
+          "Render the tune also with this SID model into the right channel "
+          "on a second engine",
+          GST_TYPE_AB_SID_MODEL, SIDDECFP_AB_NONE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_ENGINE_POOL_STATS,
+      g_param_spec_boxed ("engine-pool-stats", "Engine pool statistics",
+          "Usage, exhaustion and wait times of the process wide engine pool",
+          GST_TYPE_STRUCTURE,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_RENDER_AHEAD,
+      g_param_spec_uint ("render-ahead", "Render ahead",
+          "Blocks to buffer, rendered ahead on a separate thread, for multi "
+          "SID tunes and when the thread is tuned. Only buffering, all chips "
+          "still run on one thread (0 = render on the streaming thread)", 0, 64, DEFAULT_RENDER_AHEAD,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_SHARED_SCHEDULER,
+      g_param_spec_boolean ("shared-scheduler", "Shared scheduler",
+          "Render on the process wide scheduler threads, earliest deadline "
+          "first", DEFAULT_SHARED_SCHEDULER,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_OVER_BUDGET,
+      g_param_spec_enum ("over-budget", "Over budget",
+          "What to do with tunes that do not fit in the CPU budget",
+          GST_TYPE_OVER_BUDGET, DEFAULT_OVER_BUDGET,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_COST,
+      g_param_spec_double ("cost", "Cost",
+          "Estimated CPU cores needed by the playing tune", 0, G_MAXDOUBLE, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_CPU_AFFINITY,
+      g_param_spec_string ("cpu-affinity", "CPU affinity",
+          "CPUs to run the render ahead thread on, e.g. \"2\" or "
+          "\"0,2-3\". Moves single SID tunes to that thread too, no effect "
+          "with render-ahead=0 or shared-scheduler (NULL = any)", NULL,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_SCHEDULING_POLICY,
+      g_param_spec_enum ("scheduling-policy", "Scheduling policy",
+          "Scheduling policy of the render ahead thread. Moves single SID "
+          "tunes to that thread too, no effect with render-ahead=0 or "
+          "shared-scheduler",
+          GST_TYPE_SCHEDULING_POLICY, DEFAULT_SCHEDULING_POLICY,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_SCHEDULING_PRIORITY,
+      g_param_spec_int ("scheduling-priority", "Scheduling priority",
+          "Realtime priority of the render ahead thread, see "
+          "scheduling-policy (0 = lowest of the policy)",
+          0, 99, DEFAULT_SCHEDULING_PRIORITY,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_THREAD_NAME,
+      g_param_spec_string ("thread-name", "Thread name",
+          "Name of the render ahead thread, at most 15 characters are used. "
+          "Moves single SID tunes to that thread too, no effect with "
+          "render-ahead=0 or shared-scheduler (NULL = keep)", NULL,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_SONGLENGTH_DB,
+      g_param_spec_string ("songlength-db", "Song length database",
+          "HVSC Songlengths.md5 file to take tune lengths from "
+          "(NULL = play until the tune stops)", NULL,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_SEEK_HISTORY,
+      g_param_spec_uint64 ("seek-history", "Seek history",
+          "Rendered audio kept for backward seeks, in nanoseconds (0 = none)",
+          0, G_MAXUINT64, DEFAULT_SEEK_HISTORY,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_ALL_SUBTUNES,
+      g_param_spec_boolean ("all-subtunes", "All subtunes",
+          "Play all subtunes of the file one after another",
+          DEFAULT_ALL_SUBTUNES,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_MAX_LENGTH,
+      g_param_spec_uint64 ("max-length", "Maximum length",
+          "End tunes of unknown length after this long, in nanoseconds "
+          "(0 = no limit)", 0, G_MAXUINT64, DEFAULT_MAX_LENGTH,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_SKIP_LEADING_SILENCE,
+      g_param_spec_boolean ("skip-leading-silence", "Skip leading silence",
+          "Start the output of each tune at its first sound",
+          DEFAULT_SKIP_LEADING_SILENCE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_SILENCE_THRESHOLD,
+      g_param_spec_uint ("silence-threshold", "Silence threshold",
+          "Largest sample value still taken as silence",
+          0, G_MAXINT16, DEFAULT_SILENCE_THRESHOLD,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_SILENCE_DURATION,
+      g_param_spec_uint64 ("silence-duration", "Silence duration",
+          "End the tune after this long of silence, in nanoseconds "
+          "(0 = disabled)", 0, G_MAXUINT64, DEFAULT_SILENCE_DURATION,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_LOOP_DETECTION,
+      g_param_spec_boolean ("loop-detection", "Loop detection",
+          "Detect where the tune starts over from the SID registers",
+          DEFAULT_LOOP_DETECTION,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_MAX_LOOPS,
+      g_param_spec_uint ("max-loops", "Maximum loops",
+          "End the tune after this many detected loops (0 = play on)",
+          0, G_MAXUINT, DEFAULT_MAX_LOOPS,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
   gst_element_class_set_static_metadata (gstelement_class, "C64 SID decoder",
       "Codec/Decoder/Audio", "Use libsidplayfp to decode SID audio tunes",
       "Joni Valtanen <jvaltane@kapsi.fi>");
 
   gst_element_class_add_static_pad_template (gstelement_class, &src_templ);
+  gst_element_class_add_static_pad_template (gstelement_class,
+      &subtune_src_templ);
   gst_element_class_add_static_pad_template (gstelement_class, &sink_templ);
 
   GST_DEBUG_CATEGORY_INIT (gst_siddecfp_debug, "siddecfp", 0,
@@ -336,79 +771,291 @@ gst_siddecfp_class_init (GstSidDecFpClass * klass)
   gst_type_mark_as_plugin_api (GST_TYPE_SID_MODEL, static_cast<GstPluginAPIFlags>(0));
   gst_type_mark_as_plugin_api (GST_TYPE_CIA_MODEL, static_cast<GstPluginAPIFlags>(0));
   gst_type_mark_as_plugin_api (GST_TYPE_SAMPLING_METHOD, static_cast<GstPluginAPIFlags>(0));
+  gst_type_mark_as_plugin_api (GST_TYPE_AB_SID_MODEL, static_cast<GstPluginAPIFlags>(0));
+  gst_type_mark_as_plugin_api (GST_TYPE_OVER_BUDGET, static_cast<GstPluginAPIFlags>(0));
+  gst_type_mark_as_plugin_api (GST_TYPE_SCHEDULING_POLICY, static_cast<GstPluginAPIFlags>(0));
 }
 
-static gboolean
-is_sidbuilder_valid (sidbuilder *builder)
+/* sidplayfp takes whole factors only, 100% to 3200% */
+static void
+set_fast_forward (GstSidDecFp * siddecfp, guint percent)
 {
-    if (builder == NULL) return FALSE;
-    if (!builder->getStatus ()) return FALSE;
-    return TRUE;
+  if (!siddecfp->player->fastForward (percent))
+    GST_WARNING_OBJECT (siddecfp, "could not fast-forward at %u%%", percent);
+  if (siddecfp->ab_player != NULL)
+    siddecfp->ab_player->fastForward (percent);
 }
 
-static gboolean
-create_builder (GstSidDecFp * siddecfp)
+/* the A/B player differs from the player only in its SID model */
+static void
+configure_ab_player (GstSidDecFp * siddecfp, SidConfig config)
 {
-  sidbuilder *builder = siddecfp->config.sidEmulation;
-  siddecfp->config.sidEmulation = NULL;
-  if (builder != NULL) {
-    delete builder;
-    builder = NULL;
+  config.sidEmulation = siddecfp->ab_builder;
+  config.defaultSidModel = siddecfp->ab_sid_model == SIDDECFP_AB_MOS8580 ?
+      SidConfig::MOS8580 : SidConfig::MOS6581;
+  config.forceSidModel = true;
+  siddecfp->ab_player->config (config);
+}
+
+/* configures the player with the properties, adjusted to the emulation */
+static void
+apply_config (GstSidDecFp * siddecfp)
+{
+  SidConfig config;
+
+  /* the engine may be prepared in the background while the properties
+   * and the subtune pads read the configuration */
+  GST_OBJECT_LOCK (siddecfp);
+  config = siddecfp->config;
+  GST_OBJECT_UNLOCK (siddecfp);
+
+  if (siddecfp->emulation_in_use == SIDDECFP_EMULATION_PREVIEW) {
+    /* ReSID's fast sampling, no interpolation */
+    config.samplingMethod = SidConfig::INTERPOLATE;
+    config.fastSampling = true;
   }
-  if (siddecfp->emulation == SIDDECFP_EMULATION_RESIDFP) {
-    ReSIDfpBuilder *rsfp = new ReSIDfpBuilder ("ReSIDfp");
-    if (!is_sidbuilder_valid (rsfp)) {
-      return FALSE;
-    }
-    rsfp->create ((siddecfp->player->info ()).maxsids ());
-    if (!is_sidbuilder_valid (rsfp)) {
-      return FALSE;
-    }
-    rsfp->filter (false);
-    if (!is_sidbuilder_valid (rsfp)) {
-      return FALSE;
-    }
 
-    rsfp->filter6581Curve (siddecfp->filter_curve_6581);
-    rsfp->filter8580Curve (siddecfp->filter_curve_8580);
+  /* reconfiguring restarts the loaded song, which reads the tune */
+  g_mutex_lock (&siddecfp->tune_lock);
+  siddecfp->player->config (config);
+  if (siddecfp->ab_player != NULL)
+    configure_ab_player (siddecfp, config);
+  g_mutex_unlock (&siddecfp->tune_lock);
+}
 
-    builder = rsfp;
+/* detaches the builder from the player and gives it back to the pool */
+static void
+release_builder (GstSidDecFp * siddecfp)
+{
+  if (siddecfp->builder == NULL)
+    return;
 
-    GST_DEBUG_OBJECT (siddecfp, "using ReSIDfp emulation");
-  } else if (siddecfp->emulation == SIDDECFP_EMULATION_RESID) {
-    ReSIDBuilder *rs = new ReSIDBuilder("ReSID");
-    if (!is_sidbuilder_valid (rs)) {
-      return FALSE;
-    }
-    rs->create ((siddecfp->player->info ()).maxsids ());
-    if (!is_sidbuilder_valid (rs)) {
-      return FALSE;
-    }
-    rs->filter (false);
-    if (!is_sidbuilder_valid (rs)) {
-      return FALSE;
-    }
-    rs->bias (siddecfp->filter_bias);
+  GST_OBJECT_LOCK (siddecfp);
+  siddecfp->config.sidEmulation = NULL;
+  GST_OBJECT_UNLOCK (siddecfp);
+  if (siddecfp->player != NULL)
+    apply_config (siddecfp);
 
-    builder = rs;
+  gst_siddecfp_builder_pool_release (siddecfp->builder, &siddecfp->builder_key);
+  siddecfp->builder = NULL;
+}
 
-    GST_DEBUG_OBJECT (siddecfp, "using ReSID emulation");
+static gboolean
+acquire_engine (GstSidDecFp * siddecfp)
+{
+  if (siddecfp->player != NULL)
+    return TRUE;
 
-  } else {
+  /* state changes must not block, fail when the pool is exhausted */
+  siddecfp->player = gst_siddecfp_engine_pool_acquire (FALSE);
+  if (siddecfp->player == NULL)
     return FALSE;
+
+  apply_config (siddecfp);
+  return TRUE;
+}
+
+static void
+release_engine (GstSidDecFp * siddecfp)
+{
+  if (siddecfp->player == NULL)
+    return;
+
+  release_builder (siddecfp);
+  gst_siddecfp_engine_pool_release (siddecfp->player);
+  siddecfp->player = NULL;
+}
+
+static gboolean
+create_builder (GstSidDecFp * siddecfp)
+{
+  SidDecFpBuilderKey key;
+
+  if (siddecfp->emulation_in_use == SIDDECFP_EMULATION_NULL) {
+    release_builder (siddecfp);
+    GST_DEBUG_OBJECT (siddecfp, "using no SID emulation");
+    goto done;
+  }
+
+  key.emulation = siddecfp->emulation_in_use;
+  key.sids = (siddecfp->player->info ()).maxsids ();
+  GST_OBJECT_LOCK (siddecfp);
+  key.filter_curve_6581 = siddecfp->filter_curve_6581;
+  key.filter_curve_8580 = siddecfp->filter_curve_8580;
+  key.filter_bias = siddecfp->filter_bias;
+  GST_OBJECT_UNLOCK (siddecfp);
+
+  /* keep the current builder when possible, only filters may need changes */
+  if (siddecfp->builder != NULL &&
+      !gst_siddecfp_builder_configure (siddecfp->builder,
+          &siddecfp->builder_key, &key))
+    release_builder (siddecfp);
+
+  if (siddecfp->builder == NULL) {
+    siddecfp->builder = gst_siddecfp_builder_pool_acquire (&key);
+    if (siddecfp->builder == NULL)
+      return FALSE;
+    siddecfp->builder_key = key;
   }
 
-  if (builder == NULL) return FALSE;
+  GST_DEBUG_OBJECT (siddecfp, "using %s emulation", siddecfp->builder->name ());
 
+done:
+  GST_OBJECT_LOCK (siddecfp);
   if (siddecfp->kernal != NULL) siddecfp->player->setKernal (siddecfp->kernal->data);
   if (siddecfp->basic != NULL) siddecfp->player->setBasic (siddecfp->basic->data);
   if (siddecfp->chargen != NULL) siddecfp->player->setChargen (siddecfp->chargen->data);
+  siddecfp->config.sidEmulation = siddecfp->builder;
+  GST_OBJECT_UNLOCK (siddecfp);
 
-  siddecfp->config.sidEmulation = builder;
-  siddecfp->player->config (siddecfp->config);
+  apply_config (siddecfp);
   return TRUE;
 }
 
+/* Copies the settings changed by the properties to the ones the streaming
+ * thread uses and returns what changed. Several property changes between
+ * two blocks are thereby applied at once. */
+static guint
+take_settings (GstSidDecFp * siddecfp)
+{
+  SidDecFpSettings *settings = &siddecfp->settings;
+  guint changed;
+
+  GST_OBJECT_LOCK (siddecfp);
+  changed = siddecfp->settings_changed;
+  siddecfp->settings_changed = 0;
+
+  /* setting a property to its current value must not restart the tune */
+  if ((changed & SIDDECFP_CHANGED_CONFIG) &&
+      siddecfp->config.defaultC64Model == settings->config.defaultC64Model &&
+      siddecfp->config.forceC64Model == settings->config.forceC64Model &&
+      siddecfp->config.defaultSidModel == settings->config.defaultSidModel &&
+      siddecfp->config.forceSidModel == settings->config.forceSidModel &&
+      siddecfp->config.ciaModel == settings->config.ciaModel &&
+      siddecfp->config.samplingMethod == settings->config.samplingMethod &&
+      siddecfp->config.digiBoost == settings->config.digiBoost)
+    changed &= ~SIDDECFP_CHANGED_CONFIG;
+
+  if (changed & SIDDECFP_CHANGED_CONFIG) {
+    siddecfp->config.defaultC64Model = settings->config.defaultC64Model;
+    siddecfp->config.forceC64Model = settings->config.forceC64Model;
+    siddecfp->config.defaultSidModel = settings->config.defaultSidModel;
+    siddecfp->config.forceSidModel = settings->config.forceSidModel;
+    siddecfp->config.ciaModel = settings->config.ciaModel;
+    siddecfp->config.samplingMethod = settings->config.samplingMethod;
+    siddecfp->config.digiBoost = settings->config.digiBoost;
+  }
+  if (changed & SIDDECFP_CHANGED_FILTER) {
+    siddecfp->filter_curve_6581 = settings->filter_curve_6581;
+    siddecfp->filter_curve_8580 = settings->filter_curve_8580;
+    siddecfp->filter_bias = settings->filter_bias;
+  }
+  if (changed & SIDDECFP_CHANGED_BLOCKSIZE)
+    siddecfp->blocksize = settings->blocksize;
+  if (changed & SIDDECFP_CHANGED_RATE)
+    siddecfp->rate = settings->rate;
+  if (changed & SIDDECFP_CHANGED_SILENCE) {
+    siddecfp->silence_threshold = settings->silence_threshold;
+    siddecfp->silence_duration = settings->silence_duration;
+  }
+  if (changed & SIDDECFP_CHANGED_PLAYBACK) {
+    siddecfp->max_length = settings->max_length;
+    siddecfp->skip_leading_silence = settings->skip_leading_silence;
+    siddecfp->all_subtunes = settings->all_subtunes;
+    siddecfp->loop_detection = settings->loop_detection;
+  }
+  GST_OBJECT_UNLOCK (siddecfp);
+
+  return changed;
+}
+
+/* Applies changed settings while playing, between two blocks. Only what
+ * changed is reconfigured: filter changes are handed to the builder, and
+ * only changes of the player configuration restart the machine. */
+static void
+update_settings (GstSidDecFp * siddecfp)
+{
+  SidDecFpBuilderKey key;
+  guint changed;
+
+  changed = take_settings (siddecfp);
+  if (changed == 0)
+    return;
+
+  GST_DEBUG_OBJECT (siddecfp, "applying changed settings 0x%x", changed);
+
+  if ((changed & SIDDECFP_CHANGED_FILTER) && siddecfp->builder != NULL) {
+    key = siddecfp->builder_key;
+    key.filter_curve_6581 = siddecfp->filter_curve_6581;
+    key.filter_curve_8580 = siddecfp->filter_curve_8580;
+    key.filter_bias = siddecfp->filter_bias;
+    gst_siddecfp_builder_configure (siddecfp->builder,
+        &siddecfp->builder_key, &key);
+    if (siddecfp->ab_builder != NULL)
+      gst_siddecfp_builder_configure (siddecfp->ab_builder,
+          &siddecfp->ab_builder_key, &key);
+  }
+
+  if (changed & SIDDECFP_CHANGED_CONFIG) {
+    apply_config (siddecfp);
+    /* the player restarted the tune */
+    siddecfp->tune_time_ms = 0;
+    siddecfp->null_frames = siddecfp->null_rest = 0;
+    siddecfp->silent_bytes = 0;
+    reset_loop_detection (siddecfp);
+  }
+
+  if (changed & SIDDECFP_CHANGED_RATE) {
+    set_fast_forward (siddecfp, (guint) (siddecfp->rate * 100));
+    reset_loop_detection (siddecfp);
+  }
+}
+
+/* builds the sid builder, roms and player configuration while the element
+ * waits for data, so only reading and loading the tune is left to do when
+ * the data is complete */
+static gpointer
+prepare_engine (GstSidDecFp * siddecfp)
+{
+  GST_DEBUG_OBJECT (siddecfp, "preparing engine");
+
+  take_settings (siddecfp);
+  if (!create_builder (siddecfp))
+    GST_WARNING_OBJECT (siddecfp, "could not prepare builder");
+
+  return NULL;
+}
+
+static void
+start_prepare_engine (GstSidDecFp * siddecfp)
+{
+  GError *err = NULL;
+
+  if (siddecfp->prepare_thread != NULL)
+    return;
+
+  GST_OBJECT_LOCK (siddecfp);
+  siddecfp->emulation_in_use = siddecfp->emulation;
+  GST_OBJECT_UNLOCK (siddecfp);
+  siddecfp->prepare_thread = g_thread_try_new ("siddecfp-prepare",
+      (GThreadFunc) prepare_engine, siddecfp, &err);
+  if (siddecfp->prepare_thread == NULL) {
+    /* not fatal, start_play_tune prepares the engine then */
+    GST_WARNING_OBJECT (siddecfp, "could not start prepare thread: %s",
+        err->message);
+    g_error_free (err);
+  }
+}
+
+static void
+wait_engine_prepared (GstSidDecFp * siddecfp)
+{
+  if (siddecfp->prepare_thread == NULL)
+    return;
+
+  g_thread_join (siddecfp->prepare_thread);
+  siddecfp->prepare_thread = NULL;
+}
 
 static void
 gst_siddecfp_init (GstSidDecFp * siddecfp)
@@ -424,13 +1071,14 @@ gst_siddecfp_init (GstSidDecFp * siddecfp)
   gst_pad_use_fixed_caps (siddecfp->srcpad);
   gst_element_add_pad (GST_ELEMENT (siddecfp), siddecfp->srcpad);
 
-  siddecfp->player = new sidplayfp ();
+  /* the player is checked out from the engine pool in READY */
+  siddecfp->player = NULL;
   siddecfp->tune = new SidTune (0);
 
   siddecfp->emulation = DEFAULT_EMULATION;    /* emulation */
 
   /* get default config parameters */
-  siddecfp->config = siddecfp->player->config ();
+  siddecfp->config = SidConfig ();
 
   siddecfp->config.defaultSidModel = DEFAULT_SID_MODEL;         /* sid model */
   siddecfp->config.defaultC64Model = DEFAULT_C64_MODEL;         /* c64 model */
@@ -439,18 +1087,86 @@ gst_siddecfp_init (GstSidDecFp * siddecfp)
   siddecfp->config.forceC64Model = DEFAULT_FORCE_C64_MODEL;     /* force c64 model */
   siddecfp->config.samplingMethod = DEFAULT_SAMPLING_METHOD;    /* sampling method */
 
-  siddecfp->player->config (siddecfp->config);
-
   siddecfp->tune_buffer = (guchar *) g_malloc (MAX_SID_TUNE_BUF_SIZE);
   siddecfp->tune_len = 0;
+  g_queue_init (&siddecfp->pending_tunes);
   siddecfp->tune_number = 0;
+  g_mutex_init (&siddecfp->tune_lock);
+  siddecfp->song = 0;
+  siddecfp->seek_percent = -1;
+  siddecfp->song_length = GST_CLOCK_TIME_NONE;
+  siddecfp->skip_leading_silence = DEFAULT_SKIP_LEADING_SILENCE;
+  siddecfp->seek_history = DEFAULT_SEEK_HISTORY;
+  g_queue_init (&siddecfp->history);
+  siddecfp->all_subtunes = DEFAULT_ALL_SUBTUNES;
+  siddecfp->song_starts = g_array_new (FALSE, FALSE, sizeof (GstClockTime));
+  siddecfp->max_length = DEFAULT_MAX_LENGTH;
+  siddecfp->loop_detection = DEFAULT_LOOP_DETECTION;
+  siddecfp->max_loops = DEFAULT_MAX_LOOPS;
+  siddecfp->loop_start = siddecfp->loop_period = GST_CLOCK_TIME_NONE;
   siddecfp->total_bytes = 0;
   siddecfp->blocksize = DEFAULT_BLOCKSIZE;
+  siddecfp->filter_curve_6581 = DEFAULT_FILTER_CURVE_6581;
+  siddecfp->filter_curve_8580 = DEFAULT_FILTER_CURVE_8580;
+  siddecfp->filter_bias = DEFAULT_FILTER_BIAS;
+
+  siddecfp->settings.config = siddecfp->config;
+  siddecfp->settings.filter_curve_6581 = siddecfp->filter_curve_6581;
+  siddecfp->settings.filter_curve_8580 = siddecfp->filter_curve_8580;
+  siddecfp->settings.filter_bias = siddecfp->filter_bias;
+  siddecfp->settings.blocksize = siddecfp->blocksize;
+  siddecfp->settings.rate = siddecfp->rate = 1.0;
+  siddecfp->settings.silence_threshold = siddecfp->silence_threshold =
+      DEFAULT_SILENCE_THRESHOLD;
+  siddecfp->settings.silence_duration = siddecfp->silence_duration =
+      DEFAULT_SILENCE_DURATION;
+  siddecfp->settings.max_length = siddecfp->max_length;
+  siddecfp->settings.skip_leading_silence = siddecfp->skip_leading_silence;
+  siddecfp->settings.all_subtunes = siddecfp->all_subtunes;
+  siddecfp->settings.loop_detection = siddecfp->loop_detection;
+  siddecfp->settings.seek_history = siddecfp->seek_history;
+  siddecfp->settings_changed = 0;
+  siddecfp->channels = 1;
+  siddecfp->ab_sid_model = SIDDECFP_AB_NONE;
+  siddecfp->settings.render_ahead = siddecfp->render_ahead =
+      DEFAULT_RENDER_AHEAD;
+  siddecfp->shared_scheduler = DEFAULT_SHARED_SCHEDULER;
+  siddecfp->over_budget = DEFAULT_OVER_BUDGET;
+  siddecfp->sched_policy = DEFAULT_SCHEDULING_POLICY;
+  siddecfp->sched_priority = DEFAULT_SCHEDULING_PRIORITY;
+  g_queue_init (&siddecfp->rendered);
+  g_mutex_init (&siddecfp->render_lock);
+  g_cond_init (&siddecfp->render_cond);
 
   siddecfp->have_group_id = FALSE;
   siddecfp->group_id = G_MAXUINT;
 }
 
+static void
+release_ab_player (GstSidDecFp * siddecfp)
+{
+  SidConfig config;
+
+  if (siddecfp->ab_player != NULL) {
+    /* detach the builder before it goes back to the pool */
+    config = siddecfp->ab_player->config ();
+    config.sidEmulation = NULL;
+    g_mutex_lock (&siddecfp->tune_lock);
+    siddecfp->ab_player->config (config);
+    g_mutex_unlock (&siddecfp->tune_lock);
+    gst_siddecfp_engine_pool_release (siddecfp->ab_player);
+    siddecfp->ab_player = NULL;
+  }
+  if (siddecfp->ab_builder != NULL) {
+    gst_siddecfp_builder_pool_release (siddecfp->ab_builder,
+        &siddecfp->ab_builder_key);
+    siddecfp->ab_builder = NULL;
+  }
+  g_free (siddecfp->ab_scratch);
+  siddecfp->ab_scratch = NULL;
+  siddecfp->ab_scratch_len = 0;
+}
+
 static void
 gst_siddecfp_finalize (GObject * object)
 {
@@ -461,19 +1177,159 @@ gst_siddecfp_finalize (GObject * object)
   if (siddecfp->chargen != NULL) g_byte_array_free (siddecfp->chargen, TRUE);
 
   g_free (siddecfp->tune_buffer);
-
-  delete (siddecfp->config.sidEmulation);
+  sid_reg_log_writer_free (siddecfp->reglog);
+  g_free (siddecfp->register_log);
+  sid_song_length_db_unref (siddecfp->songlengths);
+  g_free (siddecfp->songlength_db);
+  if (siddecfp->toc != NULL)
+    gst_toc_unref (siddecfp->toc);
+  g_array_free (siddecfp->song_starts, TRUE);
+  sid_loop_detector_free (siddecfp->loop_detector);
+  g_free (siddecfp->cpu_affinity);
+  g_free (siddecfp->thread_name);
+  release_ab_player (siddecfp);
+  g_queue_clear_full (&siddecfp->pending_tunes, (GDestroyNotify) g_bytes_unref);
+
+  stop_render_ahead (siddecfp, NULL);
+  clear_history (siddecfp);
+  g_mutex_clear (&siddecfp->render_lock);
+  g_cond_clear (&siddecfp->render_cond);
+
+  wait_engine_prepared (siddecfp);
+  release_engine (siddecfp);
   delete (siddecfp->tune);
-  delete (siddecfp->player);
+  g_mutex_clear (&siddecfp->tune_lock);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
 static void
-update_tags (GstSidDecFp * siddecfp)
+set_cost (GstSidDecFp * siddecfp, gdouble cost)
+{
+  GST_OBJECT_LOCK (siddecfp);
+  siddecfp->cost = cost;
+  GST_OBJECT_UNLOCK (siddecfp);
+}
+
+/* forget everything about the previous input and output stream, but keep
+ * the player and the sid builder so the next tune starts on a warm engine */
+static void
+gst_siddecfp_reset (GstSidDecFp * siddecfp)
+{
+  siddecfp->tune_len = 0;
+  GST_OBJECT_LOCK (siddecfp);
+  g_queue_clear_full (&siddecfp->pending_tunes, (GDestroyNotify) g_bytes_unref);
+  GST_OBJECT_UNLOCK (siddecfp);
+  siddecfp->total_bytes = 0;
+  clear_history (siddecfp);
+  siddecfp->have_group_id = FALSE;
+  siddecfp->group_id = G_MAXUINT;
+
+  sid_reg_log_writer_free (siddecfp->reglog);
+  siddecfp->reglog = NULL;
+
+  sid_song_length_db_unref (siddecfp->songlengths);
+  siddecfp->songlengths = NULL;
+  siddecfp->song_length = GST_CLOCK_TIME_NONE;
+
+  sid_loop_detector_free (siddecfp->loop_detector);
+  siddecfp->loop_detector = NULL;
+  siddecfp->loop_start = siddecfp->loop_period = GST_CLOCK_TIME_NONE;
+
+  release_ab_player (siddecfp);
+
+  gst_siddecfp_budget_release (siddecfp->cost);
+  set_cost (siddecfp, 0);
+}
+
+static GstStateChangeReturn
+gst_siddecfp_change_state (GstElement * element, GstStateChange transition)
+{
+  GstSidDecFp *siddecfp = GST_SIDDECFP (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_NULL_TO_READY:
+      if (!acquire_engine (siddecfp))
+        goto no_engine;
+      start_prepare_engine (siddecfp);
+      break;
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      gst_siddecfp_reset (siddecfp);
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE)
+    goto failure;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      /* pads are flushing now, so play_loop can not block anymore */
+      stop_render_ahead (siddecfp, NULL);
+      gst_pad_stop_task (siddecfp->srcpad);
+      stop_subtune_pads (siddecfp);
+      gst_siddecfp_reset (siddecfp);
+      break;
+    case GST_STATE_CHANGE_READY_TO_NULL:
+      wait_engine_prepared (siddecfp);
+      release_engine (siddecfp);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+
+  /* ERRORS */
+no_engine:
+  {
+    GST_ELEMENT_ERROR (siddecfp, RESOURCE, BUSY,
+        ("No free sidplayfp engine"), ("engine pool exhausted"));
+    return GST_STATE_CHANGE_FAILURE;
+  }
+failure:
+  {
+    /* the element stays in NULL, give back what going to READY took */
+    if (transition == GST_STATE_CHANGE_NULL_TO_READY) {
+      wait_engine_prepared (siddecfp);
+      release_engine (siddecfp);
+    }
+    return ret;
+  }
+}
+
+/* Selects @song of the tune, 0 for its start song, and loads it into
+ * @player. The parsed tune is shared with the engines of the subtune
+ * pads, so the selection always goes back to the song of the element's
+ * own player. */
+static gboolean
+load_song (GstSidDecFp * siddecfp, sidplayfp * player, guint song)
+{
+  gboolean res;
+
+  g_mutex_lock (&siddecfp->tune_lock);
+  res = siddecfp->tune->selectSong (song) != 0 &&
+      player->load (siddecfp->tune);
+  if (res && player == siddecfp->player) {
+    siddecfp->song = siddecfp->tune->getInfo ()->currentSong ();
+    if (siddecfp->ab_player != NULL)
+      siddecfp->ab_player->load (siddecfp->tune);
+  }
+  else if (siddecfp->song != 0)
+    siddecfp->tune->selectSong (siddecfp->song);
+  g_mutex_unlock (&siddecfp->tune_lock);
+
+  return res;
+}
+
+static GstTagList *
+create_song_tags (GstSidDecFp * siddecfp, guint song)
 {
   const SidTuneInfo *info;
-  GstTagList *list;
+  GstTagList *list = NULL;
   gint count;
   gchar *info_str;
   gsize bytes_read;
@@ -510,50 +1366,301 @@ update_tags (GstSidDecFp * siddecfp)
       }
       g_free (info_str);
     }
-    gst_pad_push_event (siddecfp->srcpad, gst_event_new_tag (list));
+    gst_tag_list_add (list, GST_TAG_MERGE_REPLACE,
+        GST_TAG_TRACK_NUMBER, song,
+        GST_TAG_TRACK_COUNT, info->songs (), (void *) NULL);
   }
+
+  return list;
 }
 
-static gboolean
-siddecfp_negotiate (GstSidDecFp * siddecfp)
+static GstTagList *
+create_tags (GstSidDecFp * siddecfp)
 {
-  GstCaps *allowed;
-  GstStructure *structure;
-  int rate = 44100;
-  int channels = 1;
-  GstCaps *caps;
-  const gchar *str;
-  GstAudioFormat format;
-  GstEvent *event;
-  gchar *stream_id;
+  return create_song_tags (siddecfp, siddecfp->song);
+}
 
-  allowed = gst_pad_get_allowed_caps (siddecfp->srcpad);
-  if (!allowed)
-    goto nothing_allowed;
+static void
+update_tags (GstSidDecFp * siddecfp)
+{
+  GstTagList *list = create_tags (siddecfp);
 
-  GST_DEBUG_OBJECT (siddecfp, "allowed caps: %" GST_PTR_FORMAT, allowed);
+  if (list != NULL)
+    gst_pad_push_event (siddecfp->srcpad, gst_event_new_tag (list));
+}
 
-  allowed = gst_caps_normalize (allowed);
+/* HVSC databases since #68 key tunes by the MD5 of the whole file, older
+ * ones by libsidplayfp's MD5 of parts of it */
+static void
+compute_md5 (GstSidDecFp * siddecfp, GBytes * tune)
+{
+  gconstpointer data;
+  const char *md5_old;
+  gchar *md5;
+  gsize size;
+
+  siddecfp->md5[0] = siddecfp->md5_old[0] = '\0';
+  if (siddecfp->songlengths == NULL)
+    return;
+
+  data = g_bytes_get_data (tune, &size);
+  md5 = g_compute_checksum_for_data (G_CHECKSUM_MD5,
+      (const guchar *) data, size);
+  g_strlcpy (siddecfp->md5, md5, sizeof (siddecfp->md5));
+  g_free (md5);
+
+  md5_old = siddecfp->tune->createMD5 ();
+  if (md5_old != NULL)
+    g_strlcpy (siddecfp->md5_old, md5_old, sizeof (siddecfp->md5_old));
+}
 
-  structure = gst_caps_get_structure (allowed, 0);
+static GstClockTime
+song_length_of (GstSidDecFp * siddecfp, guint song)
+{
+  GstClockTime length = GST_CLOCK_TIME_NONE;
 
-  str = gst_structure_get_string (structure, "format");
-  if (str == NULL)
-    goto invalid_format;
+  if (siddecfp->songlengths != NULL &&
+      !sid_song_length_db_lookup (siddecfp->songlengths, siddecfp->md5,
+          song, &length))
+    sid_song_length_db_lookup (siddecfp->songlengths, siddecfp->md5_old,
+        song, &length);
 
-  format = gst_audio_format_from_string (str);
-  switch (format) {
-    case GST_AUDIO_FORMAT_S16:
-      break;
-    default:
-      goto invalid_format;
+  return length;
+}
+
+static void
+update_song_length (GstSidDecFp * siddecfp)
+{
+  GstClockTime length;
+
+  length = song_length_of (siddecfp, siddecfp->song);
+  if (length == siddecfp->song_length)
+    return;
+
+  GST_DEBUG_OBJECT (siddecfp, "song length %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (length));
+  siddecfp->song_length = length;
+  gst_element_post_message (GST_ELEMENT (siddecfp),
+      gst_message_new_duration_changed (GST_OBJECT (siddecfp)));
+}
+
+/* stream time subtune @song starts at with all_subtunes, as far as known
+ * from the subtunes played so far and the song length database. With
+ * skip-leading-silence each subtune takes its length less its lead-in,
+ * which is only known once played, so nothing is predicted then. */
+static GstClockTime
+song_start (GstSidDecFp * siddecfp, guint song)
+{
+  GArray *starts = siddecfp->song_starts;
+  GstClockTime start = 0, length;
+  guint i;
+
+  for (i = 1; i <= song; i++) {
+    if (i <= starts->len &&
+        GST_CLOCK_TIME_IS_VALID (g_array_index (starts, GstClockTime, i - 1))) {
+      start = g_array_index (starts, GstClockTime, i - 1);
+    } else if (i > 1) {
+      length = song_length_of (siddecfp, i - 1);
+      if (!GST_CLOCK_TIME_IS_VALID (start) ||
+          !GST_CLOCK_TIME_IS_VALID (length) || siddecfp->skip_leading_silence)
+        start = GST_CLOCK_TIME_NONE;
+      else
+        start += length;
+    }
+  }
+
+  return start;
+}
+
+/* sized once per tune, queries read it while the tune plays */
+static void
+reset_song_starts (GstSidDecFp * siddecfp)
+{
+  const SidTuneInfo *info = siddecfp->tune->getInfo ();
+  GstClockTime none = GST_CLOCK_TIME_NONE;
+  guint i, songs;
+
+  songs = info != NULL ? info->songs () : 0;
+  g_array_set_size (siddecfp->song_starts, 0);
+  for (i = 0; i < songs; i++)
+    g_array_append_val (siddecfp->song_starts, none);
+}
+
+static void
+mark_song_start (GstSidDecFp * siddecfp)
+{
+  guint song;
+
+  if (!siddecfp->all_subtunes)
+    return;
+
+  song = siddecfp->song;
+  if (song >= 1 && song <= siddecfp->song_starts->len)
+    g_array_index (siddecfp->song_starts, GstClockTime, song - 1) =
+        siddecfp->tune_start_time;
+}
+
+/* continues with the next subtune of the file with all_subtunes */
+static gboolean
+play_next_song (GstSidDecFp * siddecfp)
+{
+  const SidTuneInfo *info = siddecfp->tune->getInfo ();
+  guint song;
+
+  if (!siddecfp->all_subtunes || info == NULL ||
+      siddecfp->song >= info->songs ())
+    return FALSE;
+
+  song = siddecfp->song + 1;
+  GST_DEBUG_OBJECT (siddecfp, "switching to subtune %u", song);
+
+  if (!load_song (siddecfp, siddecfp->player, song))
+    return FALSE;
+
+  song_loaded (siddecfp);
+
+  return TRUE;
+}
+
+static GstToc *
+create_toc (GstSidDecFp * siddecfp)
+{
+  const SidTuneInfo *info;
+  GstTocEntry *edition, *entry;
+  GstTagList *tags;
+  GstClockTime length, start, stop;
+  GstToc *toc;
+  gchar *uid;
+  guint song;
+
+  info = siddecfp->tune->getInfo ();
+  if (info == NULL)
+    return NULL;
+
+  toc = gst_toc_new (GST_TOC_SCOPE_GLOBAL);
+  edition = gst_toc_entry_new (GST_TOC_ENTRY_TYPE_EDITION, "subtunes");
+  for (song = 1; song <= info->songs (); song++) {
+    uid = g_strdup_printf ("tune-%u", song);
+    entry = gst_toc_entry_new (GST_TOC_ENTRY_TYPE_TRACK, uid);
+    g_free (uid);
+
+    length = song_length_of (siddecfp, song);
+    if (siddecfp->all_subtunes) {
+      start = song_start (siddecfp, song);
+      stop = song_start (siddecfp, song + 1);
+      if (!GST_CLOCK_TIME_IS_VALID (stop) && GST_CLOCK_TIME_IS_VALID (start) &&
+          GST_CLOCK_TIME_IS_VALID (length))
+        stop = start + length;
+    } else {
+      start = 0;
+      stop = length;
+    }
+    gst_toc_entry_set_start_stop_times (entry,
+        GST_CLOCK_TIME_IS_VALID (start) ? (gint64) start : -1,
+        GST_CLOCK_TIME_IS_VALID (stop) ? (gint64) stop : -1);
+
+    tags = gst_tag_list_new_empty ();
+    gst_tag_list_add (tags, GST_TAG_MERGE_REPLACE,
+        GST_TAG_TRACK_NUMBER, song,
+        GST_TAG_TRACK_COUNT, info->songs (), (void *) NULL);
+    if (GST_CLOCK_TIME_IS_VALID (length))
+      gst_tag_list_add (tags, GST_TAG_MERGE_REPLACE,
+          GST_TAG_DURATION, length, (void *) NULL);
+    gst_toc_entry_set_tags (entry, tags);
+
+    gst_toc_entry_append_sub_entry (edition, entry);
+  }
+  gst_toc_append_entry (toc, edition);
+
+  return toc;
+}
+
+/* takes @toc */
+static void
+update_toc (GstSidDecFp * siddecfp, GstToc * toc)
+{
+  if (toc == NULL)
+    return;
+
+  GST_OBJECT_LOCK (siddecfp);
+  if (siddecfp->toc != NULL)
+    gst_toc_unref (siddecfp->toc);
+  siddecfp->toc = gst_toc_ref (toc);
+  GST_OBJECT_UNLOCK (siddecfp);
+
+  gst_element_post_message (GST_ELEMENT (siddecfp),
+      gst_message_new_toc (GST_OBJECT (siddecfp), toc, FALSE));
+  gst_pad_push_event (siddecfp->srcpad, gst_event_new_toc (toc, FALSE));
+  gst_toc_unref (toc);
+}
+
+static gboolean
+siddecfp_negotiate (GstSidDecFp * siddecfp)
+{
+  GstCaps *allowed, *ab_allowed;
+  GstStructure *structure;
+  int rate = 44100;
+  int channels = 1;
+  GstCaps *caps;
+  const gchar *str;
+  GstAudioFormat format;
+  GstEvent *event;
+  gchar *stream_id;
+
+  allowed = gst_pad_get_allowed_caps (siddecfp->srcpad);
+  if (!allowed)
+    goto nothing_allowed;
+
+  GST_DEBUG_OBJECT (siddecfp, "allowed caps: %" GST_PTR_FORMAT, allowed);
+
+  /* A/B renders are mono, with the alternative in the second channel */
+  siddecfp->ab_enabled = FALSE;
+  if (siddecfp->ab_sid_model != SIDDECFP_AB_NONE) {
+    caps = gst_caps_new_simple ("audio/x-raw",
+        "channels", G_TYPE_INT, 2, NULL);
+    ab_allowed = gst_caps_intersect (allowed, caps);
+    gst_caps_unref (caps);
+
+    if (siddecfp->emulation_in_use == SIDDECFP_EMULATION_NULL) {
+      GST_ELEMENT_WARNING (siddecfp, CORE, NOT_IMPLEMENTED, (NULL),
+          ("A/B rendering needs a SID emulation"));
+    } else if (gst_caps_is_empty (ab_allowed)) {
+      GST_ELEMENT_WARNING (siddecfp, CORE, NEGOTIATION, (NULL),
+          ("A/B rendering needs two channels, downstream does not allow them"));
+    } else {
+      gst_caps_unref (allowed);
+      allowed = gst_caps_ref (ab_allowed);
+      siddecfp->ab_enabled = TRUE;
+    }
+    gst_caps_unref (ab_allowed);
+  }
+
+  allowed = gst_caps_normalize (allowed);
+
+  structure = gst_caps_get_structure (allowed, 0);
+
+  str = gst_structure_get_string (structure, "format");
+  if (str == NULL)
+    goto invalid_format;
+
+  format = gst_audio_format_from_string (str);
+  switch (format) {
+    case GST_AUDIO_FORMAT_S16:
+      break;
+    default:
+      goto invalid_format;
   }
 
   gst_structure_get_int (structure, "rate", &rate);
+  GST_OBJECT_LOCK (siddecfp);
   siddecfp->config.frequency = rate;
   gst_structure_get_int (structure, "channels", &channels);
-  siddecfp->config.playback = (channels == 1) ?
+  if (siddecfp->ab_enabled)
+    channels = 2;
+  siddecfp->channels = channels;
+  siddecfp->config.playback = (channels == 1 || siddecfp->ab_enabled) ?
       SidConfig::MONO : SidConfig::STEREO;
+  GST_OBJECT_UNLOCK (siddecfp);
 
   stream_id =
       gst_pad_create_stream_id (siddecfp->srcpad, GST_ELEMENT_CAST (siddecfp),
@@ -582,13 +1689,13 @@ siddecfp_negotiate (GstSidDecFp * siddecfp)
       "format", G_TYPE_STRING, gst_audio_format_to_string (format),
       "layout", G_TYPE_STRING, "interleaved",
       "rate", G_TYPE_INT, siddecfp->config.frequency,
-      "channels", G_TYPE_INT, siddecfp->config.playback, NULL);
+      "channels", G_TYPE_INT, siddecfp->channels, NULL);
   gst_pad_set_caps (siddecfp->srcpad, caps);
   gst_caps_unref (caps);
 
   gst_caps_unref (allowed);
 
-  siddecfp->player->config (siddecfp->config);
+  apply_config (siddecfp);
 
   return TRUE;
 
@@ -598,111 +1705,2198 @@ nothing_allowed:
     GST_DEBUG_OBJECT (siddecfp, "could not get allowed caps");
     return FALSE;
   }
-invalid_format:
-  {
-    GST_DEBUG_OBJECT (siddecfp, "invalid audio caps");
-    gst_caps_unref (allowed);
-    return FALSE;
+invalid_format:
+  {
+    GST_DEBUG_OBJECT (siddecfp, "invalid audio caps");
+    gst_caps_unref (allowed);
+    return FALSE;
+  }
+}
+
+static guint64
+player_time_ms (sidplayfp * player)
+{
+#ifdef HAVE_SIDPLAYFP_TIME_MS
+  return player->timeMs ();
+#else
+  return (guint64) player->time () * 1000;
+#endif
+}
+
+static guint64
+time_ms_to_bytes (GstSidDecFp * siddecfp, guint64 ms)
+{
+  return gst_util_uint64_scale (ms, siddecfp->config.frequency, 1000) *
+      2 * siddecfp->channels;
+}
+
+/* clock of the C64 model sidplayfp picks for the loaded tune with
+ * @config */
+static guint32
+c64_clock_for (GstSidDecFp * siddecfp, const SidConfig * config)
+{
+  const SidTuneInfo *info = siddecfp->tune->getInfo ();
+  SidConfig::c64_model_t model = config->defaultC64Model;
+
+  if (!config->forceC64Model && info != NULL) {
+    if (info->clockSpeed () == SidTuneInfo::CLOCK_PAL)
+      model = SidConfig::PAL;
+    else if (info->clockSpeed () == SidTuneInfo::CLOCK_NTSC)
+      model = SidConfig::NTSC;
+  }
+
+  switch (model) {
+    case SidConfig::NTSC:
+    case SidConfig::OLD_NTSC:
+    case SidConfig::PAL_M:
+      return 1022727;
+    case SidConfig::DREAN:
+      return 1023440;
+    case SidConfig::PAL:
+    default:
+      return 985248;
+  }
+}
+
+static guint32
+c64_clock (GstSidDecFp * siddecfp)
+{
+  return c64_clock_for (siddecfp, &siddecfp->config);
+}
+
+/* cycles per video frame, how often most players run */
+static guint32
+c64_frame_cycles (GstSidDecFp * siddecfp)
+{
+  switch (c64_clock (siddecfp)) {
+    case 1022727:
+      return 65 * 263;
+    case 1023440:
+      return 65 * 312;
+    default:
+      return 63 * 312;
+  }
+}
+
+/* samples per channel from @bytes to the end of the C64 frame it is in */
+static guint
+samples_to_frame_end (GstSidDecFp * siddecfp, guint64 bytes)
+{
+  guint64 sample, frame, cycles;
+  guint32 clock;
+
+  clock = c64_clock (siddecfp);
+  cycles = (guint64) c64_frame_cycles (siddecfp) * siddecfp->config.frequency;
+  sample = bytes / (2 * siddecfp->channels);
+  frame = gst_util_uint64_scale (sample, clock, cycles) + 1;
+
+  return gst_util_uint64_scale_ceil (frame, cycles, clock) - sample;
+}
+
+/* a missing or broken database only costs the lengths */
+static void
+open_songlengths (GstSidDecFp * siddecfp)
+{
+  gchar *location;
+  GError *err = NULL;
+
+  GST_OBJECT_LOCK (siddecfp);
+  location = g_strdup (siddecfp->songlength_db);
+  GST_OBJECT_UNLOCK (siddecfp);
+
+  if (location == NULL || siddecfp->songlengths != NULL) {
+    g_free (location);
+    return;
+  }
+
+  siddecfp->songlengths = sid_song_length_db_open (location, &err);
+  if (siddecfp->songlengths == NULL) {
+    GST_ELEMENT_WARNING (siddecfp, RESOURCE, OPEN_READ,
+        ("Could not open song length database"), ("%s", err->message));
+    g_error_free (err);
+  }
+  g_free (location);
+}
+
+static gboolean
+open_register_log (GstSidDecFp * siddecfp)
+{
+  if (siddecfp->register_log == NULL || siddecfp->reglog != NULL)
+    return TRUE;
+
+#ifdef HAVE_SIDPLAYFP_SID_STATUS
+  GError *err = NULL;
+
+  siddecfp->reglog = sid_reg_log_writer_new (siddecfp->register_log,
+      c64_clock (siddecfp), (siddecfp->player->info ()).maxsids (), &err);
+  if (siddecfp->reglog == NULL) {
+    GST_ELEMENT_ERROR (siddecfp, RESOURCE, OPEN_WRITE,
+        ("Could not open register log"), ("%s", err->message));
+    g_error_free (err);
+    return FALSE;
+  }
+#else
+  GST_ELEMENT_WARNING (siddecfp, LIBRARY, INIT, (NULL),
+      ("register logging needs libsidplayfp 2.2 or newer"));
+#endif
+
+  return TRUE;
+}
+
+/* Sets up the second engine of an A/B render with the builder settings of
+ * the first one and loads the tune into it, so both start together. */
+static gboolean
+create_ab_player (GstSidDecFp * siddecfp)
+{
+  release_ab_player (siddecfp);
+  if (!siddecfp->ab_enabled)
+    return TRUE;
+
+  siddecfp->ab_player = gst_siddecfp_engine_pool_acquire (TRUE);
+  if (siddecfp->ab_player == NULL)
+    goto no_engine;
+
+  siddecfp->ab_builder =
+      gst_siddecfp_builder_pool_acquire (&siddecfp->builder_key);
+  if (siddecfp->ab_builder == NULL)
+    goto no_builder;
+  siddecfp->ab_builder_key = siddecfp->builder_key;
+
+  GST_OBJECT_LOCK (siddecfp);
+  if (siddecfp->kernal != NULL) siddecfp->ab_player->setKernal (siddecfp->kernal->data);
+  if (siddecfp->basic != NULL) siddecfp->ab_player->setBasic (siddecfp->basic->data);
+  if (siddecfp->chargen != NULL) siddecfp->ab_player->setChargen (siddecfp->chargen->data);
+  GST_OBJECT_UNLOCK (siddecfp);
+
+  /* restarts the player too, both are at the start of the song then */
+  apply_config (siddecfp);
+  if (!load_song (siddecfp, siddecfp->player, siddecfp->song))
+    goto could_not_load;
+
+  siddecfp->ab_scratch_len = MAX (SEEK_CHUNK, siddecfp->config.frequency / 50 + 1);
+  siddecfp->ab_scratch = g_new (gint16, 2 * siddecfp->ab_scratch_len);
+
+  return TRUE;
+
+  /* ERRORS */
+no_engine:
+  {
+    GST_ELEMENT_ERROR (siddecfp, RESOURCE, BUSY,
+        ("No free sidplayfp engine for the A/B render"),
+        ("engine pool exhausted"));
+    return FALSE;
+  }
+no_builder:
+  {
+    release_ab_player (siddecfp);
+    GST_ELEMENT_ERROR (siddecfp, LIBRARY, INIT,
+        ("Could not create builder"), ("Could not create A/B builder"));
+    return FALSE;
+  }
+could_not_load:
+  {
+    release_ab_player (siddecfp);
+    GST_ELEMENT_ERROR (siddecfp, STREAM, DECODE,
+        ("Could not load tune"), ("Could not load tune for the A/B render"));
+    return FALSE;
+  }
+}
+
+static void
+create_loop_detector (GstSidDecFp * siddecfp)
+{
+  if (!siddecfp->loop_detection || siddecfp->loop_detector != NULL)
+    return;
+
+#ifdef HAVE_SIDPLAYFP_SID_STATUS
+  if (siddecfp->config.sidEmulation == NULL) {
+    GST_ELEMENT_WARNING (siddecfp, CORE, NOT_IMPLEMENTED, (NULL),
+        ("loop detection needs a SID emulation, try emulation=preview"));
+    return;
+  }
+  siddecfp->loop_detector = sid_loop_detector_new (LOOP_WINDOW_FRAMES,
+      LOOP_MIN_CHANGES);
+  reset_loop_detection (siddecfp);
+#else
+  GST_ELEMENT_WARNING (siddecfp, LIBRARY, INIT, (NULL),
+      ("loop detection needs libsidplayfp 2.2 or newer"));
+#endif
+}
+
+/* starts looking for loops from the current position of the tune */
+static void
+reset_loop_detection (GstSidDecFp * siddecfp)
+{
+  if (siddecfp->loop_detector == NULL)
+    return;
+
+  siddecfp->loop_base_bytes = siddecfp->rendered_bytes;
+  siddecfp->loop_base_time = player_time_ms (siddecfp->player) * GST_MSECOND;
+  sid_loop_detector_reset (siddecfp->loop_detector, siddecfp->loop_base_time);
+}
+
+#ifdef HAVE_SIDPLAYFP_SID_STATUS
+static void
+found_loop (GstSidDecFp * siddecfp, GstClockTime start, GstClockTime period)
+{
+  const SidTuneInfo *info = siddecfp->tune->getInfo ();
+  GstStructure *s;
+  guint max_loops;
+
+  GST_INFO_OBJECT (siddecfp, "loop from %" GST_TIME_FORMAT ", period %"
+      GST_TIME_FORMAT, GST_TIME_ARGS (start), GST_TIME_ARGS (period));
+
+  siddecfp->loop_start = start;
+  siddecfp->loop_period = period;
+
+  s = gst_structure_new ("siddecfp-loop",
+      "tune", G_TYPE_INT, (gint) siddecfp->song,
+      "start", G_TYPE_UINT64, start,
+      "period", G_TYPE_UINT64, period, NULL);
+  gst_element_post_message (GST_ELEMENT (siddecfp),
+      gst_message_new_element (GST_OBJECT (siddecfp), s));
+
+  GST_OBJECT_LOCK (siddecfp);
+  max_loops = siddecfp->max_loops;
+  GST_OBJECT_UNLOCK (siddecfp);
+
+  /* a length from the database is better than a guess */
+  if (max_loops == 0 || GST_CLOCK_TIME_IS_VALID (siddecfp->song_length))
+    return;
+
+  siddecfp->song_length = start + max_loops * period;
+  gst_element_post_message (GST_ELEMENT (siddecfp),
+      gst_message_new_duration_changed (GST_OBJECT (siddecfp)));
+}
+#endif
+
+/* samples the registers after a frame, for the log and loop detection. @frame_end tells a whole C64 frame was rendered. */
+static void
+snapshot_registers (GstSidDecFp * siddecfp, guint64 bytes, gboolean frame_end)
+{
+#ifdef HAVE_SIDPLAYFP_SID_STATUS
+  guint8 regs[32];
+  guint64 cycle, state = 0;
+  GstClockTime time, start, period;
+  gboolean detect;
+  guint chip;
+
+  detect = frame_end && siddecfp->loop_detector != NULL &&
+      !GST_CLOCK_TIME_IS_VALID (siddecfp->loop_period) &&
+      siddecfp->rate == 1.0;
+
+  cycle = gst_util_uint64_scale (bytes / (2 * siddecfp->channels),
+      c64_clock (siddecfp), siddecfp->config.frequency);
+
+  for (chip = 0; chip < SID_REG_LOG_MAX_CHIPS; chip++) {
+    if (!siddecfp->player->getSidStatus (chip, regs))
+      break;
+    if (siddecfp->reglog != NULL)
+      sid_reg_log_writer_snapshot (siddecfp->reglog, cycle, chip, regs);
+    if (detect)
+      state = sid_loop_hash_registers (state, regs, SID_REG_LOG_REGS);
+  }
+
+  if (detect) {
+    time = siddecfp->loop_base_time + gst_util_uint64_scale (bytes -
+        siddecfp->loop_base_bytes, GST_SECOND,
+        (guint64) siddecfp->config.frequency * 2 * siddecfp->channels);
+    if (sid_loop_detector_push (siddecfp->loop_detector, state, time,
+            &start, &period))
+      found_loop (siddecfp, start, period);
+  }
+#else
+  (void) frame_end;
+#endif
+}
+
+/* Plays @samples samples and as many on the A/B player, which has to
+ * stay in step. Returns what the player played. */
+static guint
+play_players (GstSidDecFp * siddecfp, gint16 * data, guint samples)
+{
+  guint n, done = 0, m;
+
+  n = siddecfp->player->play (data, samples);
+  while (siddecfp->ab_player != NULL && done < n) {
+    m = siddecfp->ab_player->play (siddecfp->ab_scratch,
+        MIN (n - done, siddecfp->ab_scratch_len));
+    if (m == 0)
+      break;
+    done += m;
+  }
+
+  return n;
+}
+
+/* renders @frames mono frames and the alternative into stereo @data */
+static guint
+render_ab_frames (GstSidDecFp * siddecfp, gint16 * data, guint frames,
+    guint64 bytes)
+{
+  gint16 *a = siddecfp->ab_scratch;
+  gint16 *b = siddecfp->ab_scratch + siddecfp->ab_scratch_len;
+  guint i, n, m, to_end;
+
+  to_end = samples_to_frame_end (siddecfp, bytes);
+  frames = MIN (frames, siddecfp->ab_scratch_len);
+  n = siddecfp->player->play (a, frames);
+  if (n == 0)
+    return 0;
+  m = siddecfp->ab_player->play (b, n);
+  if (m < n)
+    memset (b + m, 0, (n - m) * sizeof (gint16));
+
+  if (siddecfp->reglog != NULL || siddecfp->loop_detector != NULL)
+    snapshot_registers (siddecfp, bytes + n * 4, n == to_end);
+
+  for (i = 0; i < n; i++) {
+    data[2 * i] = a[i];
+    data[2 * i + 1] = b[i];
+  }
+
+  return n * 2;
+}
+
+/* Renders up to @samples samples. With a register log or loop detection
+ * the block is split at the ends of C64 frames and the registers are
+ * sampled after each piece; A/B renders go in pieces of a frame too. */
+static guint
+render_block (GstSidDecFp * siddecfp, gint16 * data, guint samples)
+{
+  guint done = 0, frame, n;
+  gboolean ab = siddecfp->ab_player != NULL;
+
+  if (siddecfp->reglog == NULL && siddecfp->loop_detector == NULL && !ab)
+    return siddecfp->player->play (data, samples);
+
+  /* whole stereo frames only */
+  if (ab)
+    samples &= ~1u;
+
+  while (done < samples) {
+    frame = samples_to_frame_end (siddecfp,
+        siddecfp->rendered_bytes + done * 2);
+    if (ab) {
+      n = render_ab_frames (siddecfp, data + done,
+          MIN (frame, (samples - done) / 2), siddecfp->rendered_bytes + done * 2);
+    } else {
+      frame *= siddecfp->channels;
+      n = siddecfp->player->play (data + done, MIN (frame, samples - done));
+      if (n > 0)
+        snapshot_registers (siddecfp, siddecfp->rendered_bytes + (done + n) * 2,
+            n == frame);
+    }
+    if (n == 0)
+      break;
+    done += n;
+  }
+
+  return done;
+}
+
+/* Without chips sidplayfp only clocks the machine for a while and writes
+ * nothing, so output as much silence as time was emulated, in blocks of
+ * at most blocksize. */
+static guint
+render_null_block (GstSidDecFp * siddecfp, GstBuffer ** out)
+{
+  guint frame_size = 2 * siddecfp->channels;
+  gint16 unused[2];
+  guint64 now, scaled;
+  guint size, rate;
+
+  while (siddecfp->null_frames == 0) {
+    if (siddecfp->player->play (unused, G_N_ELEMENTS (unused)) == 0)
+      return 0;
+    now = player_time_ms (siddecfp->player);
+    if (now <= siddecfp->tune_time_ms)
+      continue;
+
+    /* fast-forward does not apply without chips, scale the time instead.
+     * Rates are whole factors, what is left of a frame carries over. */
+    rate = MAX ((guint) siddecfp->rate, 1);
+    scaled = (now - siddecfp->tune_time_ms) * siddecfp->config.frequency +
+        siddecfp->null_rest;
+    siddecfp->null_frames = scaled / (1000 * rate);
+    siddecfp->null_rest = scaled % (1000 * rate);
+    siddecfp->tune_time_ms = now;
+  }
+
+  size = MIN (siddecfp->null_frames, siddecfp->blocksize / frame_size);
+  size = MAX (size, 1);
+  siddecfp->null_frames -= size;
+  size *= frame_size;
+
+  *out = gst_buffer_new_and_alloc (size);
+  gst_buffer_memset (*out, 0, 0, size);
+
+  return size;
+}
+
+/* the cost of @players engines running the loaded tune with @config */
+static gdouble
+estimate_cost (GstSidDecFp * siddecfp, SidDecFpEmulation emulation,
+    const SidConfig * config, guint players)
+{
+  const SidTuneInfo *info = siddecfp->tune->getInfo ();
+  SidConfig::sampling_method_t method = config->samplingMethod;
+
+  if (emulation == SIDDECFP_EMULATION_PREVIEW)
+    method = SidConfig::INTERPOLATE;
+
+  return gst_siddecfp_cost_estimate (emulation,
+      info != NULL ? info->sidChips () : 1, c64_clock_for (siddecfp, config),
+      method, config->frequency) * players;
+}
+
+/* the next cheaper emulation that still produces audio */
+static gboolean
+downgrade_emulation (SidDecFpEmulation * emulation)
+{
+  switch (*emulation) {
+    case SIDDECFP_EMULATION_RESIDFP:
+      *emulation = SIDDECFP_EMULATION_RESID;
+      return TRUE;
+    case SIDDECFP_EMULATION_RESID:
+      *emulation = SIDDECFP_EMULATION_PREVIEW;
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
+/* Reserves the cost of the loaded tune from the budget in place of the
+ * previous tune's, downgrading the emulation if over-budget allows it.
+ * Called for every tune that starts, also gaplessly queued ones. */
+static gboolean
+admit_tune (GstSidDecFp * siddecfp)
+{
+  SidDecFpEmulation emulation = siddecfp->emulation_in_use;
+  gdouble cost;
+
+  for (;;) {
+    /* an A/B render emulates the chips twice */
+    cost = estimate_cost (siddecfp, emulation, &siddecfp->config,
+        siddecfp->ab_enabled ? 2 : 1);
+    if (gst_siddecfp_budget_replace (siddecfp->cost, cost,
+            siddecfp->over_budget == SIDDECFP_OVER_BUDGET_PLAY))
+      break;
+    if (siddecfp->over_budget != SIDDECFP_OVER_BUDGET_DOWNGRADE ||
+        !downgrade_emulation (&emulation))
+      goto over_budget;
+  }
+
+  set_cost (siddecfp, cost);
+  siddecfp->calibrated = FALSE;
+  siddecfp->render_time = 0;
+  siddecfp->calibration_bytes = siddecfp->rendered_bytes;
+  GST_DEBUG_OBJECT (siddecfp, "estimated cost %f cores", cost);
+
+  if (emulation != siddecfp->emulation_in_use) {
+    GST_ELEMENT_WARNING (siddecfp, RESOURCE, BUSY, (NULL),
+        ("CPU budget exceeded, downgrading emulation"));
+    siddecfp->emulation_in_use = emulation;
+    if (!create_builder (siddecfp))
+      goto could_not_create_builder;
+    /* the A/B engine follows, both restart at the start of the song */
+    if (siddecfp->ab_player != NULL && !create_ab_player (siddecfp))
+      return FALSE;
+  }
+
+  return TRUE;
+
+  /* ERRORS */
+over_budget:
+  {
+    gst_siddecfp_budget_release (siddecfp->cost);
+    set_cost (siddecfp, 0);
+    GST_ELEMENT_ERROR (siddecfp, RESOURCE, BUSY,
+        ("Not enough CPU time left to play the tune"),
+        ("estimated cost %f cores exceeds the budget", cost));
+    return FALSE;
+  }
+could_not_create_builder:
+  {
+    GST_ELEMENT_ERROR (siddecfp, LIBRARY, INIT,
+        ("Could not create builder"), ("Could not create builder"));
+    return FALSE;
+  }
+}
+
+/* measures the first CALIBRATION_TIME of the tune against the estimate */
+static void
+calibrate_cost (GstSidDecFp * siddecfp, gint64 elapsed)
+{
+  guint64 byterate = siddecfp->config.frequency * 2 * siddecfp->channels;
+  GstClockTime rendered;
+
+  siddecfp->render_time += elapsed;
+  rendered = gst_util_uint64_scale (siddecfp->rendered_bytes -
+      siddecfp->calibration_bytes, GST_SECOND, byterate);
+  if (rendered < CALIBRATION_TIME)
+    return;
+
+  gst_siddecfp_cost_calibrate (siddecfp->emulation_in_use, siddecfp->cost,
+      (gdouble) (siddecfp->render_time * GST_USECOND) / rendered);
+  siddecfp->calibrated = TRUE;
+}
+
+/* largest absolute sample value. Kept to a plain 16 bit min/max so that
+ * compilers vectorize it. */
+static guint
+peak_level (const gint16 * data, guint samples)
+{
+  gint16 lo = 0, hi = 0;
+  guint i;
+
+  for (i = 0; i < samples; i++) {
+    lo = MIN (lo, data[i]);
+    hi = MAX (hi, data[i]);
+  }
+
+  return MAX (-(gint32) lo, (gint32) hi);
+}
+
+/* a note was started on one of the chips */
+static gboolean
+notes_started (GstSidDecFp * siddecfp)
+{
+#ifdef HAVE_SIDPLAYFP_SID_STATUS
+  guint8 regs[32];
+  guint chip;
+
+  for (chip = 0; chip < SID_REG_LOG_MAX_CHIPS; chip++) {
+    if (!siddecfp->player->getSidStatus (chip, regs))
+      break;
+    /* gate bits of the three voices */
+    if ((regs[0x04] | regs[0x0b] | regs[0x12]) & 0x01)
+      return TRUE;
+  }
+#endif
+
+  return FALSE;
+}
+
+/* Runs a freshly loaded tune as fast as possible up to its first sound.
+ * The check is done every LEAD_IN_CHUNK frames of fast-forwarded output,
+ * so up to about 50 ms of the start may be cut. */
+static void
+skip_leading_silence (GstSidDecFp * siddecfp)
+{
+  gint16 scratch[LEAD_IN_CHUNK * 2];
+  guint player_channels, n;
+  gboolean sound = FALSE;
+
+  siddecfp->lead_in = 0;
+  if (!siddecfp->skip_leading_silence || siddecfp->config.sidEmulation == NULL)
+    return;
+
+  player_channels = siddecfp->config.playback == SidConfig::STEREO ? 2 : 1;
+  set_fast_forward (siddecfp, SEEK_FAST_FORWARD);
+  while (!sound && player_time_ms (siddecfp->player) < MAX_LEAD_IN_MS) {
+    n = play_players (siddecfp, scratch, LEAD_IN_CHUNK * player_channels);
+    if (n == 0)
+      break;
+    sound = peak_level (scratch, n) > siddecfp->silence_threshold ||
+        notes_started (siddecfp);
+  }
+  set_fast_forward (siddecfp, (guint) (siddecfp->rate * 100));
+
+  siddecfp->tune_time_ms = player_time_ms (siddecfp->player);
+  siddecfp->lead_in = siddecfp->tune_time_ms * GST_MSECOND;
+  reset_loop_detection (siddecfp);
+
+  GST_DEBUG_OBJECT (siddecfp, "skipped %" GST_TIME_FORMAT " of silence",
+      GST_TIME_ARGS (siddecfp->lead_in));
+}
+
+/* TRUE when the current tune should end although the player would go on */
+static gboolean
+tune_ended (GstSidDecFp * siddecfp)
+{
+  /* the length from the song length database or loop detection */
+  if (GST_CLOCK_TIME_IS_VALID (siddecfp->song_length) &&
+      player_time_ms (siddecfp->player) * GST_MSECOND >= siddecfp->song_length)
+    return TRUE;
+
+  if (!GST_CLOCK_TIME_IS_VALID (siddecfp->song_length) &&
+      siddecfp->max_length > 0 &&
+      player_time_ms (siddecfp->player) * GST_MSECOND >= siddecfp->max_length)
+    return TRUE;
+
+  if (siddecfp->stalled)
+    return TRUE;
+
+  if (siddecfp->silence_duration > 0 && siddecfp->silent_bytes >=
+      time_ms_to_bytes (siddecfp, siddecfp->silence_duration / GST_MSECOND)) {
+    GST_DEBUG_OBJECT (siddecfp, "tune went silent");
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* Renders the next block into @out. When the current tune ends the next
+ * queued one is loaded and @tags and @toc are set to its tags and TOC. Returns 0 when there
+ * is nothing left to play. */
+static guint
+render_next (GstSidDecFp * siddecfp, GstBuffer ** out, GstTagList ** tags,
+    GstToc ** toc, gdouble * rate)
+{
+  GstMapInfo outmap;
+  guint play_bytes;
+  guint64 finished_ms;
+
+  *tags = NULL;
+  *toc = NULL;
+
+  update_settings (siddecfp);
+  *rate = siddecfp->rate;
+
+  for (;;) {
+    gint64 start = g_get_monotonic_time ();
+
+    if (tune_ended (siddecfp)) {
+      *out = NULL;
+      play_bytes = 0;
+    } else if (siddecfp->config.sidEmulation == NULL) {
+      *out = NULL;
+      play_bytes = render_null_block (siddecfp, out);
+    } else {
+      *out = gst_buffer_new_and_alloc (siddecfp->blocksize);
+
+      gst_buffer_map (*out, &outmap, GST_MAP_WRITE);
+      play_bytes = render_block (siddecfp, (gint16 *)outmap.data, siddecfp->blocksize/2) * 2;
+      if (siddecfp->silence_duration > 0 && play_bytes > 0) {
+        if (peak_level ((gint16 *) outmap.data, play_bytes / 2) <=
+            siddecfp->silence_threshold)
+          siddecfp->silent_bytes += play_bytes;
+        else
+          siddecfp->silent_bytes = 0;
+      }
+      gst_buffer_unmap (*out, &outmap);
+
+      /* only a stopped player renders less, end the tune after this */
+      if (play_bytes > 0 && play_bytes < siddecfp->blocksize -
+          siddecfp->blocksize % (2 * siddecfp->channels)) {
+        GST_DEBUG_OBJECT (siddecfp, "player stopped: %s",
+            siddecfp->player->error ());
+        siddecfp->stalled = TRUE;
+        gst_buffer_set_size (*out, play_bytes);
+      }
+    }
+
+    if (play_bytes > 0) {
+      siddecfp->rendered_bytes += play_bytes;
+      if (!siddecfp->calibrated && siddecfp->rate == 1.0)
+        calibrate_cost (siddecfp, g_get_monotonic_time () - start);
+      return play_bytes;
+    }
+
+    /* the player stopped, continue gaplessly with the next tune if any */
+    if (*out != NULL)
+      gst_buffer_unref (*out);
+    *out = NULL;
+    finished_ms = player_time_ms (siddecfp->player);
+    if (!play_next_song (siddecfp) && !play_next_tune (siddecfp))
+      return 0;
+    if (!admit_tune (siddecfp))
+      return 0;
+    siddecfp->tune_start_time += finished_ms * GST_MSECOND - siddecfp->lead_in;
+    mark_song_start (siddecfp);
+    /* a fresh player state was loaded */
+    set_fast_forward (siddecfp, (guint) (siddecfp->rate * 100));
+    skip_leading_silence (siddecfp);
+
+    if (*tags != NULL)
+      gst_tag_list_unref (*tags);
+    *tags = create_tags (siddecfp);
+    if (*toc != NULL)
+      gst_toc_unref (*toc);
+    *toc = create_toc (siddecfp);
+  }
+}
+
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+/* parses a list of CPUs and ranges like "0,2-3" */
+static gboolean
+parse_cpu_set (const gchar * str, cpu_set_t * set)
+{
+  gchar **parts, *end;
+  guint64 first, last, cpu;
+  gboolean res = TRUE;
+  guint i;
+
+  CPU_ZERO (set);
+  parts = g_strsplit (str, ",", -1);
+  for (i = 0; parts[i] != NULL && res; i++) {
+    first = last = g_ascii_strtoull (parts[i], &end, 10);
+    if (end == parts[i])
+      res = FALSE;
+    else if (*end == '-')
+      last = g_ascii_strtoull (end + 1, &end, 10);
+    if (*end != '\0' || last < first || last >= CPU_SETSIZE)
+      res = FALSE;
+    for (cpu = first; res && cpu <= last; cpu++)
+      CPU_SET (cpu, set);
+  }
+  g_strfreev (parts);
+
+  return res;
+}
+#endif
+
+/* TRUE when cpu-affinity, scheduling-policy or thread-name are set */
+static gboolean
+thread_tuning_requested (GstSidDecFp * siddecfp)
+{
+  gboolean res;
+
+  GST_OBJECT_LOCK (siddecfp);
+  res = siddecfp->cpu_affinity != NULL || siddecfp->thread_name != NULL ||
+      siddecfp->sched_policy != SIDDECFP_SCHED_OTHER;
+  GST_OBJECT_UNLOCK (siddecfp);
+
+  return res;
+}
+
+/* Applies cpu-affinity, scheduling-policy and thread-name to the calling
+ * thread. Only called on the element's own render ahead thread, which
+ * ends with the tune; pooled threads are never changed. */
+static void
+tune_emulation_thread (GstSidDecFp * siddecfp)
+{
+  gchar *cpus, *name;
+  SidDecFpSchedPolicy policy;
+  gint priority;
+
+  GST_OBJECT_LOCK (siddecfp);
+  cpus = g_strdup (siddecfp->cpu_affinity);
+  name = g_strdup (siddecfp->thread_name);
+  policy = siddecfp->sched_policy;
+  priority = siddecfp->sched_priority;
+  GST_OBJECT_UNLOCK (siddecfp);
+
+#ifdef HAVE_PTHREAD_SETNAME_NP
+  if (name != NULL) {
+    gchar short_name[16];
+
+    /* Linux limits thread names to 15 characters */
+    g_strlcpy (short_name, name, sizeof (short_name));
+    pthread_setname_np (pthread_self (), short_name);
+  }
+#endif
+
+  if (cpus != NULL) {
+#ifdef HAVE_PTHREAD_SETAFFINITY_NP
+    cpu_set_t set;
+    gint err;
+
+    if (!parse_cpu_set (cpus, &set)) {
+      GST_ELEMENT_WARNING (siddecfp, RESOURCE, SETTINGS, (NULL),
+          ("invalid cpu-affinity '%s'", cpus));
+    } else if ((err = pthread_setaffinity_np (pthread_self (), sizeof (set),
+                &set)) != 0) {
+      GST_ELEMENT_WARNING (siddecfp, RESOURCE, SETTINGS, (NULL),
+          ("could not set cpu-affinity '%s': %s", cpus, g_strerror (err)));
+    } else {
+      GST_DEBUG_OBJECT (siddecfp, "render thread pinned to CPUs %s", cpus);
+    }
+#else
+    GST_ELEMENT_WARNING (siddecfp, RESOURCE, SETTINGS, (NULL),
+        ("cpu-affinity is not supported on this platform"));
+#endif
+  }
+
+  if (policy != SIDDECFP_SCHED_OTHER) {
+#ifdef HAVE_PTHREAD_SETSCHEDPARAM
+    struct sched_param param;
+    gint native = policy == SIDDECFP_SCHED_FIFO ? SCHED_FIFO : SCHED_RR;
+    gint err;
+
+    param.sched_priority = CLAMP (priority, sched_get_priority_min (native),
+        sched_get_priority_max (native));
+    err = pthread_setschedparam (pthread_self (), native, &param);
+    if (err == EPERM) {
+      GST_ELEMENT_WARNING (siddecfp, RESOURCE, SETTINGS, (NULL),
+          ("no permission for realtime scheduling, needs CAP_SYS_NICE or "
+              "an rtprio limit"));
+    } else if (err != 0) {
+      GST_ELEMENT_WARNING (siddecfp, RESOURCE, SETTINGS, (NULL),
+          ("could not set scheduling policy: %s", g_strerror (err)));
+    } else {
+      GST_DEBUG_OBJECT (siddecfp, "render thread scheduled with priority %d",
+          param.sched_priority);
+    }
+#else
+    (void) priority;
+    GST_ELEMENT_WARNING (siddecfp, RESOURCE, SETTINGS, (NULL),
+        ("scheduling-policy is not supported on this platform"));
+#endif
+  }
+
+  g_free (cpus);
+  g_free (name);
+}
+
+/* a block rendered ahead, buffer is NULL at the end of the last tune */
+typedef struct {
+  GstBuffer  *buffer;
+  guint       bytes;
+  GstTagList *tags;
+  GstToc     *toc;
+  gdouble     rate;
+} SidDecFpBlock;
+
+static void
+free_block (SidDecFpBlock * block)
+{
+  if (block->buffer != NULL)
+    gst_buffer_unref (block->buffer);
+  if (block->tags != NULL)
+    gst_tag_list_unref (block->tags);
+  if (block->toc != NULL)
+    gst_toc_unref (block->toc);
+  g_free (block);
+}
+
+/* Rendered history. Copies of the last blocks stay in memory, covering
+ * the stream bytes from history_start to history_end, where the player
+ * continues. play_loop replays them while total_bytes is below
+ * history_end. Positions are stream times, so blocks are only kept while
+ * the rate is 1.0 and timestamps and stream time agree. */
+static void
+clear_history (GstSidDecFp * siddecfp)
+{
+  g_queue_clear_full (&siddecfp->history, (GDestroyNotify) free_block);
+  siddecfp->history_start = siddecfp->history_end = siddecfp->total_bytes;
+}
+
+/* takes @block, which continues the stream at history_end */
+static void
+append_history (GstSidDecFp * siddecfp, SidDecFpBlock * block,
+    gboolean keep)
+{
+  SidDecFpBlock *oldest;
+  guint64 limit;
+
+  siddecfp->history_end += block->bytes;
+  if (!keep || siddecfp->seek_history == 0) {
+    free_block (block);
+    g_queue_clear_full (&siddecfp->history, (GDestroyNotify) free_block);
+    siddecfp->history_start = siddecfp->history_end;
+    return;
+  }
+
+  g_queue_push_tail (&siddecfp->history, block);
+
+  limit = time_ms_to_bytes (siddecfp, siddecfp->seek_history / GST_MSECOND);
+  oldest = (SidDecFpBlock *) g_queue_peek_head (&siddecfp->history);
+  while (siddecfp->history_end - siddecfp->history_start - oldest->bytes >=
+      limit) {
+    siddecfp->history_start += oldest->bytes;
+    free_block ((SidDecFpBlock *) g_queue_pop_head (&siddecfp->history));
+    oldest = (SidDecFpBlock *) g_queue_peek_head (&siddecfp->history);
+  }
+}
+
+/* keeps a copy of a block about to be pushed at @time */
+static void
+remember_block (GstSidDecFp * siddecfp, GstBuffer * out, guint bytes,
+    gdouble rate, GstClockTime time)
+{
+  SidDecFpBlock *block;
+  gboolean keep;
+
+  /* a block that did not come from the history */
+  if (siddecfp->total_bytes != siddecfp->history_end)
+    clear_history (siddecfp);
+
+  /* the history belongs to play_loop, not to the thread rendering */
+  GST_OBJECT_LOCK (siddecfp);
+  siddecfp->seek_history = siddecfp->settings.seek_history;
+  GST_OBJECT_UNLOCK (siddecfp);
+
+  keep = siddecfp->seek_history > 0 && rate == 1.0 &&
+      gst_segment_to_stream_time (&siddecfp->segment, GST_FORMAT_TIME,
+      time) == time;
+
+  block = g_new0 (SidDecFpBlock, 1);
+  block->bytes = bytes;
+  block->rate = rate;
+  if (keep)
+    block->buffer = gst_buffer_copy_deep (out);
+  append_history (siddecfp, block, keep);
+}
+
+/* the history from total_bytes to the end of the block that is in, with
+ * the tags and TOC of blocks that were not pushed yet */
+static GstBuffer *
+replay_history (GstSidDecFp * siddecfp, guint * bytes, GstTagList ** tags,
+    GstToc ** toc)
+{
+  SidDecFpBlock *block;
+  guint64 pos = siddecfp->history_start;
+  GList *l;
+  guint skip;
+
+  if (siddecfp->total_bytes < pos)
+    return NULL;
+
+  for (l = siddecfp->history.head; l != NULL; l = l->next) {
+    block = (SidDecFpBlock *) l->data;
+    if (siddecfp->total_bytes < pos + block->bytes) {
+      skip = siddecfp->total_bytes - pos;
+      *bytes = block->bytes - skip;
+      *tags = block->tags;
+      *toc = block->toc;
+      block->tags = NULL;
+      block->toc = NULL;
+      return gst_buffer_copy_region (block->buffer, GST_BUFFER_COPY_MEMORY,
+          skip, *bytes);
+    }
+    pos += block->bytes;
+  }
+
+  return NULL;
+}
+
+/* renders one block and queues it for play_loop, FALSE after the end of
+ * the last tune was queued */
+static gboolean
+render_ahead_block (GstSidDecFp * siddecfp)
+{
+  SidDecFpBlock *block;
+
+  block = g_new0 (SidDecFpBlock, 1);
+  block->bytes = render_next (siddecfp, &block->buffer, &block->tags,
+      &block->toc, &block->rate);
+
+  g_mutex_lock (&siddecfp->render_lock);
+  g_queue_push_tail (&siddecfp->rendered, block);
+  siddecfp->rendered_queued_bytes += block->bytes;
+  if (block->bytes == 0)
+    siddecfp->render_done = TRUE;
+  g_cond_broadcast (&siddecfp->render_cond);
+  g_mutex_unlock (&siddecfp->render_lock);
+
+  return block->bytes > 0;
+}
+
+/* Owns the player while running. Keeps up to render_ahead blocks queued
+ * for play_loop and stops after queueing the end of the last tune. */
+static gpointer
+render_ahead_loop (GstSidDecFp * siddecfp)
+{
+  tune_emulation_thread (siddecfp);
+
+  for (;;) {
+    g_mutex_lock (&siddecfp->render_lock);
+    while (!siddecfp->render_stop &&
+        siddecfp->rendered.length >= siddecfp->render_ahead)
+      g_cond_wait (&siddecfp->render_cond, &siddecfp->render_lock);
+    if (siddecfp->render_stop) {
+      g_mutex_unlock (&siddecfp->render_lock);
+      break;
+    }
+    g_mutex_unlock (&siddecfp->render_lock);
+
+    if (!render_ahead_block (siddecfp))
+      break;
+  }
+
+  return NULL;
+}
+
+static void run_scheduled_render (GstSidDecFp * siddecfp);
+
+/* Queues a render job unless one is queued already or enough audio is
+ * rendered. The deadline is when the rendered audio runs out if playback
+ * consumes it in realtime from now on. Called with the render lock. */
+static void
+schedule_render (GstSidDecFp * siddecfp)
+{
+  gint64 deadline;
+  guint depth = MAX (siddecfp->render_ahead, 1);
+
+  if (siddecfp->render_scheduled || siddecfp->render_stop ||
+      siddecfp->render_done || siddecfp->rendered.length >= depth)
+    return;
+
+  deadline = g_get_monotonic_time () +
+      gst_util_uint64_scale (siddecfp->rendered_queued_bytes, G_USEC_PER_SEC,
+      siddecfp->config.frequency * 2 * siddecfp->channels);
+
+  siddecfp->render_scheduled = TRUE;
+  gst_siddecfp_scheduler_push ((GstSidDecFpJobFunc) run_scheduled_render,
+      gst_object_ref (siddecfp), deadline);
+}
+
+static void
+run_scheduled_render (GstSidDecFp * siddecfp)
+{
+  gboolean stop;
+
+  g_mutex_lock (&siddecfp->render_lock);
+  stop = siddecfp->render_stop;
+  g_mutex_unlock (&siddecfp->render_lock);
+
+  if (!stop)
+    render_ahead_block (siddecfp);
+
+  g_mutex_lock (&siddecfp->render_lock);
+  siddecfp->render_scheduled = FALSE;
+  schedule_render (siddecfp);
+  g_cond_broadcast (&siddecfp->render_cond);
+  g_mutex_unlock (&siddecfp->render_lock);
+
+  gst_object_unref (siddecfp);
+}
+
+static void
+start_render_ahead (GstSidDecFp * siddecfp)
+{
+  const SidTuneInfo *info = siddecfp->tune->getInfo ();
+  GError *err = NULL;
+
+  siddecfp->render_stop = FALSE;
+  siddecfp->render_done = FALSE;
+  siddecfp->rendered_queued_bytes = 0;
+
+  /* fixed while rendering ahead, the threads read it */
+  GST_OBJECT_LOCK (siddecfp);
+  siddecfp->render_ahead = siddecfp->settings.render_ahead;
+  GST_OBJECT_UNLOCK (siddecfp);
+
+  if (siddecfp->shared_scheduler && gst_siddecfp_scheduler_init ()) {
+    GST_DEBUG_OBJECT (siddecfp, "rendering on the shared scheduler");
+    siddecfp->rendering_ahead = TRUE;
+    g_mutex_lock (&siddecfp->render_lock);
+    schedule_render (siddecfp);
+    g_mutex_unlock (&siddecfp->render_lock);
+    return;
+  }
+
+  /* a thread of its own for multi SID tunes, or to be tuned */
+  if (siddecfp->render_ahead == 0 || info == NULL ||
+      (info->sidChips () < 2 && !thread_tuning_requested (siddecfp)))
+    return;
+
+  siddecfp->render_thread = g_thread_try_new ("siddecfp-render",
+      (GThreadFunc) render_ahead_loop, siddecfp, &err);
+  if (siddecfp->render_thread == NULL) {
+    /* not fatal, play_loop renders itself then */
+    GST_WARNING_OBJECT (siddecfp, "could not start render thread: %s",
+        err->message);
+    g_error_free (err);
+    return;
+  }
+  siddecfp->rendering_ahead = TRUE;
+
+  GST_DEBUG_OBJECT (siddecfp, "buffering up to %u blocks of the %u SID tune",
+      siddecfp->render_ahead, info->sidChips ());
+}
+
+static void
+stop_render_ahead (GstSidDecFp * siddecfp, GQueue * rendered)
+{
+  SidDecFpBlock *block;
+
+  if (!siddecfp->rendering_ahead)
+    return;
+
+  g_mutex_lock (&siddecfp->render_lock);
+  siddecfp->render_stop = TRUE;
+  g_cond_broadcast (&siddecfp->render_cond);
+  while (siddecfp->render_scheduled)
+    g_cond_wait (&siddecfp->render_cond, &siddecfp->render_lock);
+  g_mutex_unlock (&siddecfp->render_lock);
+
+  if (siddecfp->render_thread != NULL) {
+    g_thread_join (siddecfp->render_thread);
+    siddecfp->render_thread = NULL;
+  }
+
+  /* the player is past the queued blocks, the caller may keep them */
+  g_mutex_lock (&siddecfp->render_lock);
+  while ((block = (SidDecFpBlock *) g_queue_pop_head (&siddecfp->rendered))) {
+    if (rendered != NULL && block->bytes > 0)
+      g_queue_push_tail (rendered, block);
+    else
+      free_block (block);
+  }
+  siddecfp->rendered_queued_bytes = 0;
+  g_mutex_unlock (&siddecfp->render_lock);
+  siddecfp->rendering_ahead = FALSE;
+}
+
+/* takes the next rendered block, NULL when stopping */
+static SidDecFpBlock *
+pop_block (GstSidDecFp * siddecfp)
+{
+  SidDecFpBlock *block;
+
+  g_mutex_lock (&siddecfp->render_lock);
+  while (!siddecfp->render_stop && siddecfp->rendered.length == 0)
+    g_cond_wait (&siddecfp->render_cond, &siddecfp->render_lock);
+  block = (SidDecFpBlock *) g_queue_pop_head (&siddecfp->rendered);
+  if (block != NULL)
+    siddecfp->rendered_queued_bytes -= block->bytes;
+  if (siddecfp->render_thread == NULL)
+    schedule_render (siddecfp);
+  g_cond_broadcast (&siddecfp->render_cond);
+  g_mutex_unlock (&siddecfp->render_lock);
+
+  return block;
+}
+
+/* posts the progress of a seek when it changed */
+static void
+post_seek_progress (GstSidDecFp * siddecfp, gint percent)
+{
+  if (percent == siddecfp->seek_percent)
+    return;
+  siddecfp->seek_percent = percent;
+
+  gst_element_post_message (GST_ELEMENT_CAST (siddecfp),
+      gst_message_new_buffering (GST_OBJECT_CAST (siddecfp), percent));
+}
+
+static guint64
+time_to_bytes (GstSidDecFp * siddecfp, GstClockTime time)
+{
+  return gst_util_uint64_scale (time, siddecfp->config.frequency, GST_SECOND) *
+      2 * siddecfp->channels;
+}
+
+/* Runs the emulation a bit closer to the seek target without output.
+ * Returns FALSE when the tune ended before the target. Buffering is at 100
+ * again when the seek is done or failed. */
+static gboolean
+seek_step (GstSidDecFp * siddecfp)
+{
+  gint16 scratch[SEEK_CHUNK];
+  guint64 target_ms, now, frames;
+  GstClockTime tune_start;
+  guint player_channels, n;
+
+  tune_start = siddecfp->tune_start_time;
+  target_ms = (siddecfp->lead_in + (siddecfp->seek_target > tune_start ?
+      siddecfp->seek_target - tune_start : 0)) / GST_MSECOND;
+  now = player_time_ms (siddecfp->player);
+
+  if (!siddecfp->seek_started) {
+    if (now > target_ms) {
+      GST_DEBUG_OBJECT (siddecfp, "restarting tune for backward seek");
+      if (!load_song (siddecfp, siddecfp->player, siddecfp->song))
+        goto could_not_restart;
+      siddecfp->tune_time_ms = 0;
+      now = 0;
+    }
+    /* the player leaves the history behind */
+    clear_history (siddecfp);
+    siddecfp->seek_from_ms = now;
+    siddecfp->seek_started = TRUE;
+    set_fast_forward (siddecfp, SEEK_FAST_FORWARD);
+    siddecfp->seek_percent = -1;
+    post_seek_progress (siddecfp, 0);
+  }
+
+  if (now + SEEK_EXACT_MS < target_ms) {
+    if (play_players (siddecfp, scratch, SEEK_CHUNK) == 0)
+      goto tune_ended;
+    post_seek_progress (siddecfp, (gint) ((now - siddecfp->seek_from_ms) *
+            100 / (target_ms - siddecfp->seek_from_ms)));
+    return TRUE;
+  }
+
+  /* close to the target, play the rest at normal speed to hit it exactly */
+  set_fast_forward (siddecfp, 100);
+  if (siddecfp->config.sidEmulation == NULL) {
+    /* without chips play() clocks a fixed time, so go by the clock */
+    while (player_time_ms (siddecfp->player) < target_ms) {
+      if (siddecfp->player->play (scratch, SEEK_CHUNK) == 0)
+        goto tune_ended;
+    }
+  } else if (target_ms > now) {
+    player_channels = siddecfp->config.playback == SidConfig::STEREO ? 2 : 1;
+    frames = gst_util_uint64_scale (target_ms - now,
+        siddecfp->config.frequency, 1000);
+    while (frames > 0) {
+      n = MIN (frames, SEEK_CHUNK / player_channels);
+      if (play_players (siddecfp, scratch, n * player_channels) == 0)
+        goto tune_ended;
+      frames -= n;
+    }
+  }
+
+  set_fast_forward (siddecfp, (guint) (siddecfp->rate * 100));
+  siddecfp->tune_time_ms = player_time_ms (siddecfp->player);
+  siddecfp->null_frames = siddecfp->null_rest = 0;
+  siddecfp->total_bytes = siddecfp->rendered_bytes =
+      time_to_bytes (siddecfp, MAX (siddecfp->seek_target, tune_start));
+  clear_history (siddecfp);
+  siddecfp->silent_bytes = 0;
+  reset_loop_detection (siddecfp);
+  siddecfp->seeking = FALSE;
+  siddecfp->seek_started = FALSE;
+  post_seek_progress (siddecfp, 100);
+
+  GST_DEBUG_OBJECT (siddecfp, "seek to %" GST_TIME_FORMAT " done",
+      GST_TIME_ARGS (siddecfp->seek_target));
+
+  return TRUE;
+
+  /* ERRORS */
+could_not_restart:
+  {
+    GST_DEBUG_OBJECT (siddecfp, "could not restart tune for backward seek");
+    post_seek_progress (siddecfp, 100);
+    return FALSE;
+  }
+tune_ended:
+  {
+    GST_DEBUG_OBJECT (siddecfp, "tune ended before the seek target");
+    set_fast_forward (siddecfp, (guint) (siddecfp->rate * 100));
+    siddecfp->seek_started = FALSE;
+    post_seek_progress (siddecfp, 100);
+    return FALSE;
+  }
+}
+
+/* The first block with a changed rate starts a new segment at @time, so
+ * timestamps and running time continue and stream time follows the rate. */
+static void
+update_segment_rate (GstSidDecFp * siddecfp, GstClockTime time, gdouble rate)
+{
+  GstSegment *segment = &siddecfp->segment;
+  guint64 stream_time, running_time;
+
+  stream_time = gst_segment_to_stream_time (segment, GST_FORMAT_TIME, time);
+  running_time = gst_segment_to_running_time (segment, GST_FORMAT_TIME, time);
+
+  segment->base = running_time;
+  segment->start = segment->position = time;
+  segment->time = stream_time;
+  segment->stop = GST_CLOCK_TIME_NONE;
+  segment->applied_rate = rate;
+
+  GST_DEBUG_OBJECT (siddecfp, "rate %f from %" GST_TIME_FORMAT, rate,
+      GST_TIME_ARGS (stream_time));
+
+  gst_pad_push_event (siddecfp->srcpad, gst_event_new_segment (segment));
+}
+
+/* Serves the seek from the history if its target is in there. The
+ * player then continues where it is once the history is played out. */
+static gboolean
+seek_in_history (GstSidDecFp * siddecfp)
+{
+  guint64 target;
+
+  if (siddecfp->seek_started || siddecfp->segment.applied_rate != 1.0)
+    return FALSE;
+
+  target = time_to_bytes (siddecfp, siddecfp->seek_target);
+  if (target < siddecfp->history_start || target >= siddecfp->history_end)
+    return FALSE;
+
+  GST_DEBUG_OBJECT (siddecfp, "seek to %" GST_TIME_FORMAT " from history",
+      GST_TIME_ARGS (siddecfp->seek_target));
+
+  siddecfp->total_bytes = target;
+  siddecfp->seeking = FALSE;
+
+  return TRUE;
+}
+
+/* stream time of the next sample to output */
+static GstClockTime
+current_stream_time (GstSidDecFp * siddecfp)
+{
+  gint64 time;
+  GstFormat format = GST_FORMAT_TIME;
+
+  if (!gst_siddecfp_src_convert (siddecfp->srcpad, GST_FORMAT_BYTES,
+          siddecfp->total_bytes, &format, &time))
+    return GST_CLOCK_TIME_NONE;
+
+  return gst_segment_to_stream_time (&siddecfp->segment, GST_FORMAT_TIME, time);
+}
+
+static void
+play_loop (GstPad * pad)
+{
+  GstFlowReturn ret;
+  GstSidDecFp *siddecfp;
+  GstBuffer *out;
+  GstTagList *tags;
+  GstToc *toc;
+  SidDecFpBlock *block;
+  gdouble rate;
+  gint64 value, offset, time = 0;
+  GstFormat format;
+  guint play_bytes;
+  gboolean replayed;
+  siddecfp = GST_SIDDECFP (gst_pad_get_parent (pad));
+
+  if (siddecfp->seeking) {
+    GstEvent *segment;
+
+    if (!seek_in_history (siddecfp) && !seek_step (siddecfp)) {
+      ret = GST_FLOW_EOS;
+      goto pause;
+    }
+    if (siddecfp->seeking)
+      goto done;
+
+    segment = gst_event_new_segment (&siddecfp->segment);
+    gst_event_set_seqnum (segment, siddecfp->seek_seqnum);
+    gst_pad_push_event (siddecfp->srcpad, segment);
+    start_render_ahead (siddecfp);
+    goto done;
+  }
+
+  replayed = FALSE;
+  if (siddecfp->total_bytes < siddecfp->history_end &&
+      (out = replay_history (siddecfp, &play_bytes, &tags, &toc)) != NULL) {
+    rate = siddecfp->segment.applied_rate;
+    replayed = TRUE;
+  } else if (siddecfp->rendering_ahead) {
+    block = pop_block (siddecfp);
+    if (block == NULL) {
+      ret = GST_FLOW_FLUSHING;
+      goto pause;
+    }
+    out = block->buffer;
+    play_bytes = block->bytes;
+    tags = block->tags;
+    toc = block->toc;
+    rate = block->rate;
+    g_free (block);
+  } else {
+    play_bytes = render_next (siddecfp, &out, &tags, &toc, &rate);
+  }
+
+  if (tags != NULL)
+    gst_pad_push_event (siddecfp->srcpad, gst_event_new_tag (tags));
+  update_toc (siddecfp, toc);
+
+  if (play_bytes == 0) {
+    ret = GST_FLOW_EOS;
+    goto pause;
+  }
+
+  /* get offset in samples */
+  format = GST_FORMAT_DEFAULT;
+  if (gst_siddecfp_src_convert (siddecfp->srcpad,
+          GST_FORMAT_BYTES, siddecfp->total_bytes, &format, &offset))
+    GST_BUFFER_OFFSET (out) = offset;
+
+  /* get current timestamp */
+  format = GST_FORMAT_TIME;
+  if (gst_siddecfp_src_convert (siddecfp->srcpad,
+          GST_FORMAT_BYTES, siddecfp->total_bytes, &format, &time))
+    GST_BUFFER_TIMESTAMP (out) = time;
+
+  if (rate != siddecfp->segment.applied_rate)
+    update_segment_rate (siddecfp, time, rate);
+
+  if (!replayed)
+    remember_block (siddecfp, out, play_bytes, rate, time);
+
+  if (GST_CLOCK_TIME_IS_VALID (siddecfp->segment.stop) &&
+      (guint64) time >= siddecfp->segment.stop) {
+    gst_buffer_unref (out);
+    ret = GST_FLOW_EOS;
+    goto pause;
+  }
+
+  /* update position and get new timestamp to calculate duration */
+  siddecfp->total_bytes += play_bytes;
+
+  /* get offset in samples */
+  format = GST_FORMAT_DEFAULT;
+  if (gst_siddecfp_src_convert (siddecfp->srcpad,
+          GST_FORMAT_BYTES, siddecfp->total_bytes, &format, &value))
+    GST_BUFFER_OFFSET_END (out) = value;
+
+  format = GST_FORMAT_TIME;
+  if (gst_siddecfp_src_convert (siddecfp->srcpad,
+          GST_FORMAT_BYTES, siddecfp->total_bytes, &format, &value))
+    GST_BUFFER_DURATION (out) = value - time;
+
+  if ((ret = gst_pad_push (siddecfp->srcpad, out)) != GST_FLOW_OK)
+    goto pause;
+
+done:
+  gst_object_unref (siddecfp);
+
+  return;
+
+  /* ERRORS */
+pause:
+  {
+    if (ret == GST_FLOW_EOS) {
+      /* perform EOS logic, FIXME, segment seek? */
+      gst_pad_push_event (pad, gst_event_new_eos ());
+    } else if (ret == GST_FLOW_NOT_LINKED && siddecfp->subtune_pads != NULL) {
+      /* only the subtune pads are used */
+      gst_pad_push_event (pad, gst_event_new_eos ());
+    } else if (ret < GST_FLOW_EOS || ret == GST_FLOW_NOT_LINKED) {
+      /* for fatal errors we post an error message */
+      GST_ELEMENT_FLOW_ERROR (siddecfp, ret);
+      gst_pad_push_event (pad, gst_event_new_eos ());
+    }
+
+    GST_INFO_OBJECT (siddecfp, "pausing task, reason: %s",
+        gst_flow_get_name (ret));
+    gst_pad_pause_task (pad);
+    goto done;
+  }
+}
+
+/* moves the collected input data to the queue of complete tunes */
+static gboolean
+commit_tune (GstSidDecFp * siddecfp)
+{
+  GBytes *tune;
+
+  if (siddecfp->tune_len == 0)
+    return FALSE;
+
+  tune = g_bytes_new (siddecfp->tune_buffer, siddecfp->tune_len);
+  siddecfp->tune_len = 0;
+
+  GST_OBJECT_LOCK (siddecfp);
+  g_queue_push_tail (&siddecfp->pending_tunes, tune);
+  GST_OBJECT_UNLOCK (siddecfp);
+
+  return TRUE;
+}
+
+static GBytes *
+pop_tune (GstSidDecFp * siddecfp)
+{
+  GBytes *tune;
+
+  GST_OBJECT_LOCK (siddecfp);
+  tune = (GBytes *) g_queue_pop_head (&siddecfp->pending_tunes);
+  GST_OBJECT_UNLOCK (siddecfp);
+
+  return tune;
+}
+
+/* resets what is kept per subtune after the player loaded one */
+static void
+song_loaded (GstSidDecFp * siddecfp)
+{
+  siddecfp->tune_time_ms = 0;
+  siddecfp->null_frames = siddecfp->null_rest = 0;
+  siddecfp->silent_bytes = 0;
+  siddecfp->stalled = FALSE;
+  siddecfp->loop_start = siddecfp->loop_period = GST_CLOCK_TIME_NONE;
+  reset_loop_detection (siddecfp);
+  update_song_length (siddecfp);
+}
+
+static gboolean
+load_tune (GstSidDecFp * siddecfp, GBytes * tune)
+{
+  gconstpointer data;
+  gsize size;
+
+  data = g_bytes_get_data (tune, &size);
+  g_mutex_lock (&siddecfp->tune_lock);
+  siddecfp->tune->read ((const uint_least8_t *) data, size);
+  siddecfp->song = 0;
+  compute_md5 (siddecfp, tune);
+  g_mutex_unlock (&siddecfp->tune_lock);
+
+  if (!load_song (siddecfp, siddecfp->player,
+          siddecfp->all_subtunes ? 1 : siddecfp->tune_number))
+    goto could_not_load;
+
+  reset_song_starts (siddecfp);
+  song_loaded (siddecfp);
+
+  return TRUE;
+
+  /* ERRORS */
+could_not_load:
+  {
+    GST_ELEMENT_ERROR (siddecfp, LIBRARY, INIT,
+        ("Could not load tune"), ("Could not select or load song %d",
+            siddecfp->all_subtunes ? 1 : siddecfp->tune_number));
+    return FALSE;
+  }
+}
+
+/* re-arms the running player with the next queued tune. Caps and segment
+ * stay as they are so timestamps continue seamlessly over tune boundaries */
+static gboolean
+play_next_tune (GstSidDecFp * siddecfp)
+{
+  GBytes *tune;
+  gboolean res;
+
+  tune = pop_tune (siddecfp);
+  if (tune == NULL)
+    return FALSE;
+
+  GST_DEBUG_OBJECT (siddecfp, "switching to next tune at %" G_GUINT64_FORMAT
+      " bytes", siddecfp->total_bytes);
+
+  res = load_tune (siddecfp, tune);
+  g_bytes_unref (tune);
+
+  return res;
+}
+
+/* Subtune pads. Each src_%u pad renders subtune %u of the tune that is
+ * playing when the pad starts, on an own engine from the engine pool and
+ * on the pad's own task, so all subtunes of a file render in parallel.
+ * The engines share the parsed tune, only selecting the song and loading
+ * it into the player needs tune_lock. */
+
+static GstClockTime
+subtune_bytes_to_time (SidDecFpSubtunePad * sub, guint64 bytes)
+{
+  return gst_util_uint64_scale (bytes / (2 * sub->channels), GST_SECOND,
+      sub->config.frequency);
+}
+
+static gboolean
+subtune_negotiate (SidDecFpSubtunePad * sub)
+{
+  GstSidDecFp *siddecfp = sub->siddecfp;
+  GstStructure *structure;
+  GstCaps *allowed, *caps;
+  GstEvent *event;
+  const gchar *str;
+  gchar *stream_id;
+  gint rate = 44100, channels = 1;
+
+  allowed = gst_pad_get_allowed_caps (sub->pad);
+  if (allowed == NULL)
+    return FALSE;
+
+  allowed = gst_caps_normalize (allowed);
+  if (gst_caps_is_empty (allowed))
+    goto invalid_format;
+  structure = gst_caps_get_structure (allowed, 0);
+
+  /* the engine only renders native 16 bit */
+  str = gst_structure_get_string (structure, "format");
+  if (str == NULL ||
+      gst_audio_format_from_string (str) != GST_AUDIO_FORMAT_S16)
+    goto invalid_format;
+
+  gst_structure_get_int (structure, "rate", &rate);
+  gst_structure_get_int (structure, "channels", &channels);
+  gst_caps_unref (allowed);
+
+  sub->config.frequency = rate;
+  sub->channels = channels;
+  sub->config.playback = channels == 1 ? SidConfig::MONO : SidConfig::STEREO;
+
+  stream_id = gst_pad_create_stream_id_printf (sub->pad,
+      GST_ELEMENT_CAST (siddecfp), "%u", sub->song);
+  event = gst_event_new_stream_start (stream_id);
+  if (siddecfp->have_group_id)
+    gst_event_set_group_id (event, siddecfp->group_id);
+  gst_pad_push_event (sub->pad, event);
+  g_free (stream_id);
+
+  caps = gst_caps_new_simple ("audio/x-raw",
+      "format", G_TYPE_STRING, gst_audio_format_to_string (GST_AUDIO_FORMAT_S16),
+      "layout", G_TYPE_STRING, "interleaved",
+      "rate", G_TYPE_INT, rate,
+      "channels", G_TYPE_INT, channels, NULL);
+  gst_pad_set_caps (sub->pad, caps);
+  gst_caps_unref (caps);
+
+  return TRUE;
+
+  /* ERRORS */
+invalid_format:
+  {
+    GST_DEBUG_OBJECT (sub->pad, "invalid format in %" GST_PTR_FORMAT, allowed);
+    gst_caps_unref (allowed);
+    return FALSE;
+  }
+}
+
+/* the settings of the element when the subtune starts */
+static void
+take_subtune_settings (SidDecFpSubtunePad * sub)
+{
+  GstSidDecFp *siddecfp = sub->siddecfp;
+
+  GST_OBJECT_LOCK (siddecfp);
+  sub->config.defaultC64Model = siddecfp->settings.config.defaultC64Model;
+  sub->config.forceC64Model = siddecfp->settings.config.forceC64Model;
+  sub->config.defaultSidModel = siddecfp->settings.config.defaultSidModel;
+  sub->config.forceSidModel = siddecfp->settings.config.forceSidModel;
+  sub->config.ciaModel = siddecfp->settings.config.ciaModel;
+  sub->config.samplingMethod = siddecfp->settings.config.samplingMethod;
+  sub->config.digiBoost = siddecfp->settings.config.digiBoost;
+  sub->builder_key.filter_curve_6581 = siddecfp->settings.filter_curve_6581;
+  sub->builder_key.filter_curve_8580 = siddecfp->settings.filter_curve_8580;
+  sub->builder_key.filter_bias = siddecfp->settings.filter_bias;
+  sub->blocksize = siddecfp->settings.blocksize;
+  sub->silence_threshold = siddecfp->settings.silence_threshold;
+  sub->silence_duration = siddecfp->settings.silence_duration;
+  sub->length = siddecfp->settings.max_length;
+  GST_OBJECT_UNLOCK (siddecfp);
+}
+
+/* Reserves the cost of the subtune from the budget like admit_tune does
+ * for the element's own player. The subtune starts with the emulation
+ * the element ended up with, or a cheaper one if over-budget allows it. */
+static gboolean
+admit_subtune (SidDecFpSubtunePad * sub, SidDecFpEmulation * emulation)
+{
+  GstSidDecFp *siddecfp = sub->siddecfp;
+  SidDecFpEmulation wanted = *emulation;
+  SidDecFpOverBudget over_budget;
+  gdouble cost;
+
+  GST_OBJECT_LOCK (siddecfp);
+  over_budget = siddecfp->over_budget;
+  GST_OBJECT_UNLOCK (siddecfp);
+
+  for (;;) {
+    cost = estimate_cost (siddecfp, *emulation, &sub->config, 1);
+    if (gst_siddecfp_budget_reserve (cost,
+            over_budget == SIDDECFP_OVER_BUDGET_PLAY))
+      break;
+    if (over_budget != SIDDECFP_OVER_BUDGET_DOWNGRADE ||
+        !downgrade_emulation (emulation))
+      return FALSE;
+  }
+
+  sub->cost = cost;
+  GST_DEBUG_OBJECT (sub->pad, "estimated cost %f cores", cost);
+
+  if (*emulation != wanted)
+    GST_ELEMENT_WARNING (siddecfp, RESOURCE, BUSY, (NULL),
+        ("CPU budget exceeded, downgrading emulation of subtune %u",
+            sub->song));
+
+  return TRUE;
+}
+
+/* configured like the element's own player, with @emulation */
+static gboolean
+create_subtune_engine (SidDecFpSubtunePad * sub, SidDecFpEmulation emulation)
+{
+  GstSidDecFp *siddecfp = sub->siddecfp;
+
+  sub->player = gst_siddecfp_engine_pool_acquire (TRUE);
+  if (sub->player == NULL)
+    return FALSE;
+
+  sub->builder_key.emulation = emulation;
+  sub->builder_key.sids = (sub->player->info ()).maxsids ();
+
+  GST_OBJECT_LOCK (siddecfp);
+  if (siddecfp->kernal != NULL) sub->player->setKernal (siddecfp->kernal->data);
+  if (siddecfp->basic != NULL) sub->player->setBasic (siddecfp->basic->data);
+  if (siddecfp->chargen != NULL) sub->player->setChargen (siddecfp->chargen->data);
+  GST_OBJECT_UNLOCK (siddecfp);
+
+  if (emulation != SIDDECFP_EMULATION_NULL) {
+    sub->builder = gst_siddecfp_builder_pool_acquire (&sub->builder_key);
+    if (sub->builder == NULL)
+      return FALSE;
+  }
+  sub->config.sidEmulation = sub->builder;
+
+  if (emulation == SIDDECFP_EMULATION_PREVIEW) {
+    SidConfig config = sub->config;
+
+    config.samplingMethod = SidConfig::INTERPOLATE;
+    config.fastSampling = true;
+    sub->player->config (config);
+  } else {
+    sub->player->config (sub->config);
+  }
+
+  return TRUE;
+}
+
+static void
+release_subtune_engine (SidDecFpSubtunePad * sub)
+{
+  if (sub->player != NULL) {
+    /* unloads the shared tune, configuring re-initializes from it */
+    g_mutex_lock (&sub->siddecfp->tune_lock);
+    sub->player->load (NULL);
+    g_mutex_unlock (&sub->siddecfp->tune_lock);
+
+    if (sub->builder != NULL) {
+      sub->config.sidEmulation = NULL;
+      sub->player->config (sub->config);
+    }
+    gst_siddecfp_engine_pool_release (sub->player);
+    sub->player = NULL;
+  }
+  if (sub->builder != NULL) {
+    gst_siddecfp_builder_pool_release (sub->builder, &sub->builder_key);
+    sub->builder = NULL;
+  }
+
+  gst_siddecfp_budget_release (sub->cost);
+  sub->cost = 0;
+  sub->started = FALSE;
+}
+
+static gboolean
+start_subtune (SidDecFpSubtunePad * sub)
+{
+  GstSidDecFp *siddecfp = sub->siddecfp;
+  const SidTuneInfo *info;
+  GstTagList *tags;
+  GstSegment segment;
+  GstClockTime max_length;
+  SidDecFpEmulation emulation;
+  guint songs;
+
+  g_mutex_lock (&siddecfp->tune_lock);
+  info = siddecfp->tune->getInfo ();
+  songs = info != NULL ? info->songs () : 0;
+  g_mutex_unlock (&siddecfp->tune_lock);
+  if (sub->song > songs)
+    goto no_such_song;
+
+  if (!subtune_negotiate (sub))
+    goto could_not_negotiate;
+
+  take_subtune_settings (sub);
+  emulation = siddecfp->emulation_in_use;
+  if (!admit_subtune (sub, &emulation))
+    goto over_budget;
+
+  if (!create_subtune_engine (sub, emulation))
+    goto no_engine;
+
+  if (!load_song (siddecfp, sub->player, sub->song))
+    goto could_not_load;
+
+  /* max-length was taken with the settings, for tunes of unknown length */
+  max_length = sub->length;
+  g_mutex_lock (&siddecfp->tune_lock);
+  sub->length = song_length_of (siddecfp, sub->song);
+  tags = create_song_tags (siddecfp, sub->song);
+  g_mutex_unlock (&siddecfp->tune_lock);
+  if (!GST_CLOCK_TIME_IS_VALID (sub->length) && max_length > 0)
+    sub->length = max_length;
+
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  gst_pad_push_event (sub->pad, gst_event_new_segment (&segment));
+  if (tags != NULL)
+    gst_pad_push_event (sub->pad, gst_event_new_tag (tags));
+
+  sub->total_bytes = 0;
+  sub->time_ms = 0;
+  sub->null_frames = 0;
+  sub->silent_bytes = 0;
+  sub->started = TRUE;
+
+  GST_DEBUG_OBJECT (sub->pad, "rendering subtune %u", sub->song);
+
+  return TRUE;
+
+  /* ERRORS */
+no_such_song:
+  {
+    GST_ELEMENT_WARNING (siddecfp, STREAM, DECODE, (NULL),
+        ("Tune has no subtune %u, only %u", sub->song, songs));
+    return FALSE;
+  }
+could_not_negotiate:
+  {
+    GST_ELEMENT_ERROR (siddecfp, CORE, NEGOTIATION,
+        ("Could not negotiate format"), ("Could not negotiate format"));
+    return FALSE;
+  }
+over_budget:
+  {
+    GST_ELEMENT_ERROR (siddecfp, RESOURCE, BUSY,
+        ("Not enough CPU time left to play the tune"),
+        ("estimated cost of subtune %u exceeds the budget", sub->song));
+    return FALSE;
+  }
+no_engine:
+  {
+    GST_ELEMENT_ERROR (siddecfp, RESOURCE, BUSY,
+        ("No free sidplayfp engine"), ("No engine for subtune %u",
+            sub->song));
+    return FALSE;
+  }
+could_not_load:
+  {
+    GST_ELEMENT_ERROR (siddecfp, LIBRARY, INIT,
+        ("Could not load tune"), ("Could not load subtune %u", sub->song));
+    return FALSE;
+  }
+}
+
+/* renders the next block of the subtune, NULL at its end */
+static GstBuffer *
+render_subtune_block (SidDecFpSubtunePad * sub)
+{
+  GstSidDecFp *siddecfp = sub->siddecfp;
+  GstBuffer *out;
+  GstMapInfo map;
+  gint16 unused[2];
+  guint64 now;
+  guint size, blocksize = sub->blocksize;
+
+  now = player_time_ms (sub->player);
+  if (GST_CLOCK_TIME_IS_VALID (sub->length) && now * GST_MSECOND >= sub->length)
+    return NULL;
+  if (sub->silence_duration > 0 && sub->silent_bytes >=
+      gst_util_uint64_scale (sub->silence_duration / GST_MSECOND,
+          sub->config.frequency, 1000) * 2 * sub->channels)
+    return NULL;
+
+  /* without chips, as much silence as time was emulated */
+  if (sub->builder == NULL) {
+    while (sub->null_frames == 0) {
+      if (sub->player->play (unused, G_N_ELEMENTS (unused)) == 0)
+        return NULL;
+      now = player_time_ms (sub->player);
+      if (now <= sub->time_ms)
+        continue;
+      sub->null_frames =
+          gst_util_uint64_scale (now, sub->config.frequency, 1000) -
+          gst_util_uint64_scale (sub->time_ms, sub->config.frequency, 1000);
+      sub->time_ms = now;
+    }
+
+    size = MAX (MIN (sub->null_frames, blocksize / (2 * sub->channels)), 1);
+    sub->null_frames -= size;
+    size *= 2 * sub->channels;
+    out = gst_buffer_new_and_alloc (size);
+    gst_buffer_memset (out, 0, 0, size);
+    return out;
+  }
+
+  out = gst_buffer_new_and_alloc (blocksize);
+  gst_buffer_map (out, &map, GST_MAP_WRITE);
+  size = sub->player->play ((gint16 *) map.data, blocksize / 2) * 2;
+  if (sub->silence_duration > 0 && size > 0) {
+    if (peak_level ((gint16 *) map.data, size / 2) <=
+        sub->silence_threshold)
+      sub->silent_bytes += size;
+    else
+      sub->silent_bytes = 0;
+  }
+  gst_buffer_unmap (out, &map);
+
+  /* the player stopped */
+  if (size == 0) {
+    gst_buffer_unref (out);
+    return NULL;
+  }
+  if (size < blocksize)
+    gst_buffer_set_size (out, size);
+
+  return out;
+}
+
+static void
+subtune_loop (SidDecFpSubtunePad * sub)
+{
+  GstFlowReturn ret;
+  GstBuffer *out;
+  GstClockTime time;
+
+  if (!sub->started && !start_subtune (sub)) {
+    ret = GST_FLOW_EOS;
+    goto pause;
+  }
+
+  out = render_subtune_block (sub);
+  if (out == NULL) {
+    ret = GST_FLOW_EOS;
+    goto pause;
+  }
+
+  time = subtune_bytes_to_time (sub, sub->total_bytes);
+  GST_BUFFER_OFFSET (out) = sub->total_bytes / (2 * sub->channels);
+  GST_BUFFER_TIMESTAMP (out) = time;
+  sub->total_bytes += gst_buffer_get_size (out);
+  GST_BUFFER_OFFSET_END (out) = sub->total_bytes / (2 * sub->channels);
+  GST_BUFFER_DURATION (out) =
+      subtune_bytes_to_time (sub, sub->total_bytes) - time;
+
+  if ((ret = gst_pad_push (sub->pad, out)) != GST_FLOW_OK)
+    goto pause;
+
+  return;
+
+  /* ERRORS */
+pause:
+  {
+    if (ret == GST_FLOW_EOS) {
+      gst_pad_push_event (sub->pad, gst_event_new_eos ());
+    } else if (ret < GST_FLOW_EOS || ret == GST_FLOW_NOT_LINKED) {
+      GST_ELEMENT_FLOW_ERROR (sub->siddecfp, ret);
+      gst_pad_push_event (sub->pad, gst_event_new_eos ());
+    }
+
+    GST_INFO_OBJECT (sub->pad, "pausing task, reason: %s",
+        gst_flow_get_name (ret));
+    gst_pad_pause_task (sub->pad);
+  }
+}
+
+/* starts the subtune pads that did not render the tune yet */
+static void
+start_subtune_pads (GstSidDecFp * siddecfp)
+{
+  SidDecFpSubtunePad *sub;
+  GList *l;
+
+  GST_OBJECT_LOCK (siddecfp);
+  for (l = siddecfp->subtune_pads; l != NULL; l = l->next) {
+    sub = (SidDecFpSubtunePad *) l->data;
+    if (gst_pad_get_task_state (sub->pad) == GST_TASK_STOPPED)
+      gst_pad_start_task (sub->pad, (GstTaskFunction) subtune_loop, sub,
+          NULL);
   }
+  GST_OBJECT_UNLOCK (siddecfp);
 }
 
+/* the pads are flushing when this is called */
 static void
-play_loop (GstPad * pad)
+stop_subtune_pads (GstSidDecFp * siddecfp)
 {
-  GstFlowReturn ret;
-  GstSidDecFp *siddecfp;
-  GstBuffer *out;
-  GstMapInfo outmap;
-  gint64 value, offset, time = 0;
-  GstFormat format;
-  guint play_bytes;
-  siddecfp = GST_SIDDECFP (gst_pad_get_parent (pad));
+  SidDecFpSubtunePad *sub;
+  GList *pads, *l;
 
-  out = gst_buffer_new_and_alloc (siddecfp->blocksize);
+  GST_OBJECT_LOCK (siddecfp);
+  pads = g_list_copy (siddecfp->subtune_pads);
+  GST_OBJECT_UNLOCK (siddecfp);
 
-  gst_buffer_map (out, &outmap, GST_MAP_WRITE);
-  play_bytes = siddecfp->player->play ((gint16 *)outmap.data, siddecfp->blocksize/2) * 2;
-  gst_buffer_unmap (out, &outmap);
+  for (l = pads; l != NULL; l = l->next) {
+    sub = (SidDecFpSubtunePad *) l->data;
+    gst_pad_stop_task (sub->pad);
+    release_subtune_engine (sub);
+  }
+  g_list_free (pads);
+}
 
-  /* get offset in samples */
-  format = GST_FORMAT_DEFAULT;
-  if (gst_siddecfp_src_convert (siddecfp->srcpad,
-          GST_FORMAT_BYTES, siddecfp->total_bytes, &format, &offset))
-    GST_BUFFER_OFFSET (out) = offset;
+static gboolean
+subtune_src_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_SEEK:
+    case GST_EVENT_TOC_SELECT:
+      /* not forwarded, the tune data upstream is consumed already */
+      gst_event_unref (event);
+      return FALSE;
+    default:
+      return gst_pad_event_default (pad, parent, event);
+  }
+}
 
-  /* get current timestamp */
-  format = GST_FORMAT_TIME;
-  if (gst_siddecfp_src_convert (siddecfp->srcpad,
-          GST_FORMAT_BYTES, siddecfp->total_bytes, &format, &time))
-    GST_BUFFER_TIMESTAMP (out) = time;
+static gboolean
+subtune_src_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  SidDecFpSubtunePad *sub =
+      (SidDecFpSubtunePad *) gst_pad_get_element_private (pad);
+  GstFormat format;
 
-  /* update position and get new timestamp to calculate duration */
-  siddecfp->total_bytes += play_bytes;
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_POSITION:
+      gst_query_parse_position (query, &format, NULL);
+      if (format != GST_FORMAT_TIME || !sub->started)
+        return FALSE;
+      gst_query_set_position (query, format,
+          subtune_bytes_to_time (sub, sub->total_bytes));
+      return TRUE;
+    case GST_QUERY_DURATION:
+      gst_query_parse_duration (query, &format, NULL);
+      if (format != GST_FORMAT_TIME || !sub->started ||
+          !GST_CLOCK_TIME_IS_VALID (sub->length))
+        return FALSE;
+      gst_query_set_duration (query, format, sub->length);
+      return TRUE;
+    default:
+      return gst_pad_query_default (pad, parent, query);
+  }
+}
 
-  /* get offset in samples */
-  format = GST_FORMAT_DEFAULT;
-  if (gst_siddecfp_src_convert (siddecfp->srcpad,
-          GST_FORMAT_BYTES, siddecfp->total_bytes, &format, &value))
-    GST_BUFFER_OFFSET_END (out) = value;
+static GstPad *
+gst_siddecfp_request_new_pad (GstElement * element, GstPadTemplate * templ,
+    const gchar * name, const GstCaps * caps)
+{
+  GstSidDecFp *siddecfp = GST_SIDDECFP (element);
+  SidDecFpSubtunePad *sub;
+  const SidTuneInfo *info;
+  gboolean playing;
+  gchar *pad_name;
+  guint song = 0, songs;
+  GList *l;
 
-  format = GST_FORMAT_TIME;
-  if (gst_siddecfp_src_convert (siddecfp->srcpad,
-          GST_FORMAT_BYTES, siddecfp->total_bytes, &format, &value))
-    GST_BUFFER_DURATION (out) = value - time;
+  if (name != NULL && (sscanf (name, "src_%u", &song) != 1 || song == 0))
+    goto invalid_name;
 
-  if ((ret = gst_pad_push (siddecfp->srcpad, out)) != GST_FLOW_OK)
-    goto pause;
+  /* 0 when no tune is loaded yet, start_subtune checks again then */
+  g_mutex_lock (&siddecfp->tune_lock);
+  info = siddecfp->tune->getInfo ();
+  songs = info != NULL ? info->songs () : 0;
+  g_mutex_unlock (&siddecfp->tune_lock);
 
-done:
-  gst_object_unref (siddecfp);
+  GST_OBJECT_LOCK (siddecfp);
+  for (l = siddecfp->subtune_pads; l != NULL; l = l->next) {
+    guint used = ((SidDecFpSubtunePad *) l->data)->song;
 
-  return;
+    if (name == NULL)
+      song = MAX (song, used);
+    else if (used == song)
+      goto in_use;
+  }
+  if (name == NULL)
+    song++;
+  if (songs > 0 && song > songs)
+    goto no_such_song;
+
+  sub = g_new0 (SidDecFpSubtunePad, 1);
+  sub->siddecfp = siddecfp;
+  sub->song = song;
+  sub->config = SidConfig ();
+  sub->length = GST_CLOCK_TIME_NONE;
+  pad_name = g_strdup_printf ("src_%u", song);
+  sub->pad = gst_pad_new_from_template (templ, pad_name);
+  g_free (pad_name);
+  gst_pad_set_element_private (sub->pad, sub);
+  gst_pad_set_event_function (sub->pad, subtune_src_event);
+  gst_pad_set_query_function (sub->pad, subtune_src_query);
+  gst_pad_use_fixed_caps (sub->pad);
+  siddecfp->subtune_pads = g_list_append (siddecfp->subtune_pads, sub);
+  GST_OBJECT_UNLOCK (siddecfp);
+
+  gst_element_add_pad (element, sub->pad);
+
+  /* pads requested while a tune plays render that tune */
+  playing = gst_pad_get_task_state (siddecfp->srcpad) != GST_TASK_STOPPED;
+  if (playing)
+    start_subtune_pads (siddecfp);
+
+  return sub->pad;
 
   /* ERRORS */
-pause:
+invalid_name:
   {
-    if (ret == GST_FLOW_EOS) {
-      /* perform EOS logic, FIXME, segment seek? */
-      gst_pad_push_event (pad, gst_event_new_eos ());
-    } else if (ret < GST_FLOW_EOS || ret == GST_FLOW_NOT_LINKED) {
-      /* for fatal errors we post an error message */
-      GST_ELEMENT_FLOW_ERROR (siddecfp, ret);
-      gst_pad_push_event (pad, gst_event_new_eos ());
-    }
-
-    GST_INFO_OBJECT (siddecfp, "pausing task, reason: %s",
-        gst_flow_get_name (ret));
-    gst_pad_pause_task (pad);
-    goto done;
+    GST_WARNING_OBJECT (siddecfp, "invalid pad name %s", name);
+    return NULL;
   }
+in_use:
+  {
+    GST_OBJECT_UNLOCK (siddecfp);
+    GST_WARNING_OBJECT (siddecfp, "pad %s exists already", name);
+    return NULL;
+  }
+no_such_song:
+  {
+    GST_OBJECT_UNLOCK (siddecfp);
+    GST_WARNING_OBJECT (siddecfp, "tune has no subtune %u, only %u", song,
+        songs);
+    return NULL;
+  }
+}
+
+static void
+gst_siddecfp_release_pad (GstElement * element, GstPad * pad)
+{
+  GstSidDecFp *siddecfp = GST_SIDDECFP (element);
+  SidDecFpSubtunePad *sub =
+      (SidDecFpSubtunePad *) gst_pad_get_element_private (pad);
+
+  GST_OBJECT_LOCK (siddecfp);
+  siddecfp->subtune_pads = g_list_remove (siddecfp->subtune_pads, sub);
+  GST_OBJECT_UNLOCK (siddecfp);
+
+  gst_pad_set_active (pad, FALSE);
+  gst_pad_stop_task (pad);
+  release_subtune_engine (sub);
+  gst_element_remove_pad (element, pad);
+  g_free (sub);
 }
 
 static gboolean
 start_play_tune (GstSidDecFp * siddecfp)
 {
   gboolean res;
-  GstSegment segment;
+  GBytes *tune;
 
-  siddecfp->tune->read (siddecfp->tune_buffer, siddecfp->tune_len);
+  /* tunes arriving while playing are picked up by play_loop */
+  if (gst_pad_get_task_state (siddecfp->srcpad) == GST_TASK_STARTED)
+    return TRUE;
 
-  if (!siddecfp->tune->selectSong (siddecfp->tune_number))
-    goto could_not_select_song;
+  tune = pop_tune (siddecfp);
+  if (tune == NULL)
+    goto no_tune;
 
-  if (!siddecfp->player->load(siddecfp->tune))
-    goto could_not_load;
+  /* normally a no-op, the builder was prepared in the background */
+  wait_engine_prepared (siddecfp);
+  GST_OBJECT_LOCK (siddecfp);
+  siddecfp->emulation_in_use = siddecfp->emulation;
+  GST_OBJECT_UNLOCK (siddecfp);
+  take_settings (siddecfp);
+  if (!create_builder (siddecfp))
+    goto could_not_create_builder;
+
+  open_songlengths (siddecfp);
 
   if (!siddecfp_negotiate (siddecfp))
     goto could_not_negotiate;
 
-  if (!create_builder (siddecfp))
-    goto could_not_create_builder;
+  res = load_tune (siddecfp, tune);
+  g_bytes_unref (tune);
+  if (!res)
+    return FALSE;
 
-  gst_segment_init (&segment, GST_FORMAT_TIME);
-  gst_pad_push_event (siddecfp->srcpad, gst_event_new_segment (&segment));
+  if (!admit_tune (siddecfp))
+    return FALSE;
+
+  if (!open_register_log (siddecfp))
+    return FALSE;
+
+  if (!create_ab_player (siddecfp))
+    return FALSE;
+
+  create_loop_detector (siddecfp);
+
+  gst_segment_init (&siddecfp->segment, GST_FORMAT_TIME);
+  gst_pad_push_event (siddecfp->srcpad,
+      gst_event_new_segment (&siddecfp->segment));
   siddecfp->total_bytes = 0;
+  siddecfp->rendered_bytes = 0;
+  clear_history (siddecfp);
+  siddecfp->tune_start_time = 0;
+  GST_OBJECT_LOCK (siddecfp);
+  siddecfp->rate = siddecfp->settings.rate = 1.0;
+  siddecfp->settings_changed &= ~SIDDECFP_CHANGED_RATE;
+  GST_OBJECT_UNLOCK (siddecfp);
+  siddecfp->seeking = FALSE;
+  siddecfp->seek_started = FALSE;
   siddecfp->have_group_id = FALSE;
   siddecfp->group_id = G_MAXUINT;
 
+  mark_song_start (siddecfp);
+  skip_leading_silence (siddecfp);
+  update_toc (siddecfp, create_toc (siddecfp));
+
+  start_render_ahead (siddecfp);
+  start_subtune_pads (siddecfp);
+
   res = gst_pad_start_task (siddecfp->srcpad,
       (GstTaskFunction) play_loop, siddecfp->srcpad, NULL);
 
@@ -711,26 +3905,22 @@ start_play_tune (GstSidDecFp * siddecfp)
   return res;
 
   /* ERRORS */
-could_not_select_song:
-  {
-    GST_ELEMENT_ERROR (siddecfp, LIBRARY, INIT,
-        ("Could not select song"), ("Could not select song"));
-    return FALSE;
-  }
-could_not_load:
+no_tune:
   {
-    GST_ELEMENT_ERROR (siddecfp, LIBRARY, INIT,
-        ("Could not load tune"), ("Could not load tune"));
+    GST_ELEMENT_ERROR (siddecfp, STREAM, DECODE,
+        (NULL), ("No tune data received"));
     return FALSE;
   }
 could_not_negotiate:
   {
+    g_bytes_unref (tune);
     GST_ELEMENT_ERROR (siddecfp, CORE, NEGOTIATION,
         ("Could not negotiate format"), ("Could not negotiate format"));
     return FALSE;
   }
 could_not_create_builder:
   {
+    g_bytes_unref (tune);
     GST_ELEMENT_ERROR (siddecfp, LIBRARY, INIT,
         ("Could not create builder"), ("Could not create builder"));
     return FALSE;
@@ -746,9 +3936,20 @@ gst_siddecfp_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
   siddecfp = GST_SIDDECFP (parent);
 
   switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_STREAM_START:
+      /* a new file starts, e.g. from concat, so the data so far is a tune
+       * that can already be played */
+      res = commit_tune (siddecfp) ? start_play_tune (siddecfp) : TRUE;
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      siddecfp->tune_len = 0;
+      res = TRUE;
+      break;
     case GST_EVENT_EOS:
+      commit_tune (siddecfp);
       res = start_play_tune (siddecfp);
       break;
+    case GST_EVENT_CAPS:
     case GST_EVENT_SEGMENT:
       res = TRUE;
       break;
@@ -807,7 +4008,7 @@ gst_siddecfp_src_convert (GstPad * pad, GstFormat src_format, gint64 src_value,
   }
 
   bytes_per_sample =
-      (16 >> 3) * siddecfp->config.playback;
+      (16 >> 3) * siddecfp->channels;
 
   switch (src_format) {
     case GST_FORMAT_BYTES:
@@ -868,12 +4069,254 @@ gst_siddecfp_src_convert (GstPad * pad, GstFormat src_format, gint64 src_value,
   return res;
 }
 
+/* stops the streaming thread for a seek, returns with the stream lock */
+static void
+begin_seek (GstSidDecFp * siddecfp, gboolean flush, guint32 seqnum)
+{
+  GQueue rendered = G_QUEUE_INIT;
+  SidDecFpBlock *block;
+  GstEvent *flush_event;
+
+  if (flush) {
+    flush_event = gst_event_new_flush_start ();
+    gst_event_set_seqnum (flush_event, seqnum);
+    gst_pad_push_event (siddecfp->srcpad, flush_event);
+  }
+
+  /* the render ahead thread stops first, play_loop may wait for it */
+  stop_render_ahead (siddecfp, &rendered);
+  gst_pad_pause_task (siddecfp->srcpad);
+
+  GST_PAD_STREAM_LOCK (siddecfp->srcpad);
+
+  /* play_loop has remembered what it pushed, the blocks it did not get to
+   * follow them in the history */
+  while ((block = (SidDecFpBlock *) g_queue_pop_head (&rendered)))
+    append_history (siddecfp, block, block->rate == 1.0);
+
+  if (flush) {
+    flush_event = gst_event_new_flush_stop (TRUE);
+    gst_event_set_seqnum (flush_event, seqnum);
+    gst_pad_push_event (siddecfp->srcpad, flush_event);
+  }
+}
+
+/* lets play_loop run to @target and continue from there */
+static void
+finish_seek (GstSidDecFp * siddecfp, GstClockTime target, guint32 seqnum)
+{
+  siddecfp->seek_target = target;
+  siddecfp->seek_seqnum = seqnum;
+  siddecfp->seeking = TRUE;
+  siddecfp->seek_started = FALSE;
+
+  gst_pad_start_task (siddecfp->srcpad, (GstTaskFunction) play_loop,
+      siddecfp->srcpad, NULL);
+
+  GST_PAD_STREAM_UNLOCK (siddecfp->srcpad);
+}
+
+/* Switches to subtune @song of the current tune. The player and the sid
+ * builder stay, and so do the caps. */
+static gboolean
+select_subtune (GstSidDecFp * siddecfp, guint64 song, gboolean flush,
+    guint32 seqnum)
+{
+  const SidTuneInfo *info;
+  GstClockTime start, base;
+  GstFormat format = GST_FORMAT_TIME;
+  gint64 time;
+
+  /* only the playing tune has subtunes to select */
+  if (gst_pad_get_task_state (siddecfp->srcpad) == GST_TASK_STOPPED)
+    return FALSE;
+
+  info = siddecfp->tune->getInfo ();
+  if (info == NULL || song < 1 || song > info->songs ())
+    return FALSE;
+
+  begin_seek (siddecfp, flush, seqnum);
+
+  GST_DEBUG_OBJECT (siddecfp, "switching to subtune %" G_GUINT64_FORMAT, song);
+
+  if (!load_song (siddecfp, siddecfp->player, (guint) song))
+    goto could_not_load;
+
+  GST_OBJECT_LOCK (siddecfp);
+  siddecfp->tune_number = (gint) song;
+  GST_OBJECT_UNLOCK (siddecfp);
+
+  /* the subtune is played like a new stream from 0, or from where it is
+   * in the stream of all subtunes */
+  start = 0;
+  if (siddecfp->all_subtunes) {
+    start = song_start (siddecfp, (guint) song);
+    if (!GST_CLOCK_TIME_IS_VALID (start))
+      start = current_stream_time (siddecfp);
+  }
+
+  /* without a flush the running time goes on from where the stream is,
+   * as for rate changes */
+  base = 0;
+  if (!flush && gst_siddecfp_src_convert (siddecfp->srcpad, GST_FORMAT_BYTES,
+          siddecfp->total_bytes, &format, &time)) {
+    base = gst_segment_to_running_time (&siddecfp->segment, GST_FORMAT_TIME,
+        time);
+    if (!GST_CLOCK_TIME_IS_VALID (base))
+      base = 0;
+  }
+
+  gst_segment_init (&siddecfp->segment, GST_FORMAT_TIME);
+  siddecfp->segment.base = base;
+  siddecfp->segment.start = siddecfp->segment.time =
+      siddecfp->segment.position = start;
+  siddecfp->segment.applied_rate = siddecfp->rate;
+  siddecfp->total_bytes = siddecfp->rendered_bytes =
+      time_to_bytes (siddecfp, start);
+  clear_history (siddecfp);
+  siddecfp->tune_start_time = start;
+
+  song_loaded (siddecfp);
+  mark_song_start (siddecfp);
+  set_fast_forward (siddecfp, (guint) (siddecfp->rate * 100));
+  skip_leading_silence (siddecfp);
+  update_tags (siddecfp);
+
+  finish_seek (siddecfp, start, seqnum);
+
+  return TRUE;
+
+  /* ERRORS */
+could_not_load:
+  {
+    GST_PAD_STREAM_UNLOCK (siddecfp->srcpad);
+    GST_ELEMENT_ERROR (siddecfp, LIBRARY, INIT,
+        ("Could not load subtune"), ("Could not load subtune %"
+            G_GUINT64_FORMAT, song));
+    return FALSE;
+  }
+}
+
+static gboolean
+gst_siddecfp_do_seek (GstSidDecFp * siddecfp, GstEvent * event)
+{
+  gdouble rate;
+  GstFormat format, time_format = GST_FORMAT_TIME;
+  GstSeekFlags flags;
+  GstSeekType start_type, stop_type;
+  gint64 start, stop;
+  guint32 seqnum;
+  GstEvent *rate_event;
+
+  gst_event_parse_seek (event, &rate, &format, &flags, &start_type, &start,
+      &stop_type, &stop);
+  seqnum = gst_event_get_seqnum (event);
+
+  /* applied by the sink, the emulation and the segment stay as they are */
+  if (flags & GST_SEEK_FLAG_INSTANT_RATE_CHANGE) {
+    if (rate <= 0.0 || start_type != GST_SEEK_TYPE_NONE ||
+        stop_type != GST_SEEK_TYPE_NONE)
+      goto unsupported;
+    if (gst_pad_get_task_state (siddecfp->srcpad) == GST_TASK_STOPPED)
+      goto not_playing;
+    GST_DEBUG_OBJECT (siddecfp, "instant rate change to %f", rate);
+    rate_event = gst_event_new_instant_rate_change (rate /
+        siddecfp->segment.rate,
+        (GstSegmentFlags) (flags & GST_SEGMENT_INSTANT_FLAGS));
+    gst_event_set_seqnum (rate_event, seqnum);
+    return gst_pad_push_event (siddecfp->srcpad, rate_event);
+  }
+
+  if (rate < MIN_RATE || rate > MAX_RATE)
+    goto unsupported;
+  /* anything else would play at the integer part of the rate */
+  rate = ROUND_RATE (rate);
+
+  if (format == subtune_format) {
+    if (start_type != GST_SEEK_TYPE_SET || start < 1)
+      goto unsupported;
+    return select_subtune (siddecfp, start,
+        (flags & GST_SEEK_FLAG_FLUSH) != 0, seqnum);
+  }
+
+  if (format != GST_FORMAT_TIME) {
+    if (start_type != GST_SEEK_TYPE_NONE &&
+        !gst_siddecfp_src_convert (siddecfp->srcpad, format, start,
+            &time_format, &start))
+      goto unsupported;
+    if (stop_type != GST_SEEK_TYPE_NONE && stop != -1 &&
+        !gst_siddecfp_src_convert (siddecfp->srcpad, format, stop,
+            &time_format, &stop))
+      goto unsupported;
+  }
+
+  /* only the playing tune can be seeked */
+  if (gst_pad_get_task_state (siddecfp->srcpad) == GST_TASK_STOPPED)
+    goto not_playing;
+
+  begin_seek (siddecfp, (flags & GST_SEEK_FLAG_FLUSH) != 0, seqnum);
+
+  /* a rate change only, continue from where playback is */
+  if (start_type == GST_SEEK_TYPE_NONE) {
+    start = current_stream_time (siddecfp);
+    start_type = GST_SEEK_TYPE_SET;
+  }
+
+  /* the segment is in stream time until the rate is moved to applied_rate */
+  gst_segment_init (&siddecfp->segment, GST_FORMAT_TIME);
+  gst_segment_do_seek (&siddecfp->segment, 1.0, GST_FORMAT_TIME, flags,
+      start_type, start, stop_type, stop, NULL);
+  siddecfp->segment.applied_rate = rate;
+  if (GST_CLOCK_TIME_IS_VALID (siddecfp->segment.stop))
+    siddecfp->segment.stop = siddecfp->segment.start +
+        (guint64) ((siddecfp->segment.stop - siddecfp->segment.start) / rate);
+
+  GST_OBJECT_LOCK (siddecfp);
+  siddecfp->settings.rate = rate;
+  siddecfp->settings_changed |= SIDDECFP_CHANGED_RATE;
+  GST_OBJECT_UNLOCK (siddecfp);
+
+  GST_DEBUG_OBJECT (siddecfp, "seeking to %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (siddecfp->segment.position));
+
+  finish_seek (siddecfp, siddecfp->segment.position, seqnum);
+
+  return TRUE;
+
+  /* ERRORS */
+unsupported:
+  {
+    GST_DEBUG_OBJECT (siddecfp, "unsupported seek");
+    return FALSE;
+  }
+not_playing:
+  {
+    GST_DEBUG_OBJECT (siddecfp, "no tune playing, can not seek");
+    return FALSE;
+  }
+}
+
 static gboolean
 gst_siddecfp_src_event (GstPad * pad, GstObject * parent, GstEvent * event)
 {
+  GstSidDecFp *siddecfp = GST_SIDDECFP (parent);
   gboolean res = FALSE;
 
   switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_SEEK:
+      res = gst_siddecfp_do_seek (siddecfp, event);
+      break;
+    case GST_EVENT_TOC_SELECT:
+    {
+      gchar *uid = NULL;
+
+      gst_event_parse_toc_select (event, &uid);
+      if (uid != NULL && g_str_has_prefix (uid, "tune-"))
+        res = select_subtune (siddecfp, g_ascii_strtoull (uid + 5, NULL, 10),
+            TRUE, gst_event_get_seqnum (event));
+      g_free (uid);
+      break;
+    }
     default:
       break;
   }
@@ -898,14 +4341,95 @@ gst_siddecfp_src_query (GstPad * pad, GstObject * parent, GstQuery * query)
 
       gst_query_parse_position (query, &format, NULL);
 
-      /* we only know about our bytes, convert to requested format */
-      res &= gst_siddecfp_src_convert (pad,
-          GST_FORMAT_BYTES, siddecfp->total_bytes, &format, &current);
+      if (format == subtune_format) {
+        const SidTuneInfo *info = siddecfp->tune->getInfo ();
+
+        res = info != NULL;
+        current = siddecfp->song;
+      } else if (format == GST_FORMAT_TIME) {
+        /* differs from the timestamps when playing at another rate */
+        current = current_stream_time (siddecfp);
+        res = GST_CLOCK_TIME_IS_VALID (current);
+      } else {
+        /* we only know about our bytes, convert to requested format */
+        res &= gst_siddecfp_src_convert (pad,
+            GST_FORMAT_BYTES, siddecfp->total_bytes, &format, &current);
+      }
       if (res) {
         gst_query_set_position (query, format, current);
       }
       break;
     }
+    case GST_QUERY_DURATION:
+    {
+      GstFormat format;
+      gint64 duration;
+      gboolean all_subtunes;
+
+      gst_query_parse_duration (query, &format, NULL);
+      if (format == subtune_format) {
+        const SidTuneInfo *info = siddecfp->tune->getInfo ();
+
+        res = info != NULL;
+        if (res)
+          gst_query_set_duration (query, format, info->songs ());
+        break;
+      }
+
+      /* all subtunes in one stream end with the last one */
+      GST_OBJECT_LOCK (siddecfp);
+      all_subtunes = siddecfp->all_subtunes;
+      GST_OBJECT_UNLOCK (siddecfp);
+      if (all_subtunes && siddecfp->tune->getInfo () != NULL) {
+        GstClockTime end = song_start (siddecfp,
+            siddecfp->tune->getInfo ()->songs () + 1);
+
+        res = GST_CLOCK_TIME_IS_VALID (end) &&
+            gst_siddecfp_src_convert (pad, GST_FORMAT_TIME, end, &format,
+            &duration);
+        if (res)
+          gst_query_set_duration (query, format, duration);
+        break;
+      }
+
+      /* known from the song length database only, up to the end of the
+       * current tune */
+      if (!GST_CLOCK_TIME_IS_VALID (siddecfp->song_length)) {
+        res = FALSE;
+        break;
+      }
+      res = gst_siddecfp_src_convert (pad, GST_FORMAT_TIME,
+          siddecfp->tune_start_time + siddecfp->song_length -
+          MIN (siddecfp->lead_in, siddecfp->song_length), &format,
+          &duration);
+      if (res)
+        gst_query_set_duration (query, format, duration);
+      break;
+    }
+    case GST_QUERY_SEEKING:
+    {
+      GstFormat format;
+
+      gst_query_parse_seeking (query, &format, NULL, NULL, NULL);
+      if (format == subtune_format) {
+        const SidTuneInfo *info = siddecfp->tune->getInfo ();
+
+        gst_query_set_seeking (query, format, info != NULL, 1,
+            info != NULL ? info->songs () : -1);
+      } else
+        gst_query_set_seeking (query, format, format == GST_FORMAT_TIME, 0, -1);
+      break;
+    }
+    case GST_QUERY_TOC:
+    {
+      GST_OBJECT_LOCK (siddecfp);
+      if (siddecfp->toc != NULL)
+        gst_query_set_toc (query, siddecfp->toc, NULL);
+      else
+        res = FALSE;
+      GST_OBJECT_UNLOCK (siddecfp);
+      break;
+    }
     default:
       res = gst_pad_query_default (pad, parent, query);
       break;
@@ -931,7 +4455,10 @@ gst_siddecfp_set_property (GObject * object, guint prop_id, const GValue * value
     GParamSpec * pspec)
 {
   GstSidDecFp *siddecfp = GST_SIDDECFP (object);
+  SidDecFpSettings *settings = &siddecfp->settings;
 
+  /* picked up by the streaming thread before its next block */
+  GST_OBJECT_LOCK (siddecfp);
   switch (prop_id) {
     case PROP_EMULATION:
       siddecfp->emulation = (SidDecFpEmulation)g_value_get_enum (value);
@@ -943,34 +4470,44 @@ gst_siddecfp_set_property (GObject * object, guint prop_id, const GValue * value
       siddecfp->filter = g_value_get_boolean (value);
       break;
     case PROP_C64_MODEL:
-      siddecfp->config.defaultC64Model = (SidConfig::c64_model_t)g_value_get_enum (value);
+      settings->config.defaultC64Model = (SidConfig::c64_model_t)g_value_get_enum (value);
+      siddecfp->settings_changed |= SIDDECFP_CHANGED_CONFIG;
       break;
     case PROP_SID_MODEL:
-      siddecfp->config.defaultSidModel = (SidConfig::sid_model_t)g_value_get_enum (value);
+      settings->config.defaultSidModel = (SidConfig::sid_model_t)g_value_get_enum (value);
+      siddecfp->settings_changed |= SIDDECFP_CHANGED_CONFIG;
       break;
     case PROP_CIA_MODEL:
-      siddecfp->config.ciaModel = (SidConfig::cia_model_t)g_value_get_enum (value);
+      settings->config.ciaModel = (SidConfig::cia_model_t)g_value_get_enum (value);
+      siddecfp->settings_changed |= SIDDECFP_CHANGED_CONFIG;
       break;
     case PROP_FORCE_SID_MODEL:
-      siddecfp->config.forceSidModel = g_value_get_boolean (value);
+      settings->config.forceSidModel = g_value_get_boolean (value);
+      siddecfp->settings_changed |= SIDDECFP_CHANGED_CONFIG;
       break;
     case PROP_FORCE_C64_MODEL:
-      siddecfp->config.forceC64Model = g_value_get_boolean (value);
+      settings->config.forceC64Model = g_value_get_boolean (value);
+      siddecfp->settings_changed |= SIDDECFP_CHANGED_CONFIG;
       break;
     case PROP_SAMPLING_METHOD:
-      siddecfp->config.samplingMethod = (SidConfig::sampling_method_t)g_value_get_enum (value);
+      settings->config.samplingMethod = (SidConfig::sampling_method_t)g_value_get_enum (value);
+      siddecfp->settings_changed |= SIDDECFP_CHANGED_CONFIG;
       break;
     case PROP_DIGI_BOOST:
-      siddecfp->config.digiBoost = g_value_get_boolean (value);
+      settings->config.digiBoost = g_value_get_boolean (value);
+      siddecfp->settings_changed |= SIDDECFP_CHANGED_CONFIG;
       break;
     case PROP_FILTER_CURVE_6581:
-      siddecfp->filter_curve_6581 = g_value_get_double (value);
+      settings->filter_curve_6581 = g_value_get_double (value);
+      siddecfp->settings_changed |= SIDDECFP_CHANGED_FILTER;
       break;
     case PROP_FILTER_CURVE_8580:
-      siddecfp->filter_curve_8580 = g_value_get_double (value);
+      settings->filter_curve_8580 = g_value_get_double (value);
+      siddecfp->settings_changed |= SIDDECFP_CHANGED_FILTER;
       break;
     case PROP_FILTER_BIAS:
-      siddecfp->filter_bias = g_value_get_double (value);
+      settings->filter_bias = g_value_get_double (value);
+      siddecfp->settings_changed |= SIDDECFP_CHANGED_FILTER;
       break;
     case PROP_KERNAL:
       siddecfp->kernal = copy_byte_array (siddecfp->kernal, (GByteArray *)g_value_get_boxed (value), 8192);
@@ -982,13 +4519,78 @@ gst_siddecfp_set_property (GObject * object, guint prop_id, const GValue * value
       siddecfp->chargen = copy_byte_array (siddecfp->chargen, (GByteArray *)g_value_get_boxed (value), 4096);
       break;
     case PROP_BLOCKSIZE:
-      siddecfp->blocksize = g_value_get_uint (value);
+      settings->blocksize = g_value_get_uint (value);
+      siddecfp->settings_changed |= SIDDECFP_CHANGED_BLOCKSIZE;
+      break;
+    case PROP_AB_SID_MODEL:
+      siddecfp->ab_sid_model = (SidDecFpAbModel) g_value_get_enum (value);
+      break;
+    case PROP_REGISTER_LOG:
+      g_free (siddecfp->register_log);
+      siddecfp->register_log = g_value_dup_string (value);
+      break;
+    case PROP_RENDER_AHEAD:
+      settings->render_ahead = g_value_get_uint (value);
+      break;
+    case PROP_SHARED_SCHEDULER:
+      siddecfp->shared_scheduler = g_value_get_boolean (value);
+      break;
+    case PROP_OVER_BUDGET:
+      siddecfp->over_budget = (SidDecFpOverBudget) g_value_get_enum (value);
+      break;
+    case PROP_CPU_AFFINITY:
+      g_free (siddecfp->cpu_affinity);
+      siddecfp->cpu_affinity = g_value_dup_string (value);
+      break;
+    case PROP_SCHEDULING_POLICY:
+      siddecfp->sched_policy = (SidDecFpSchedPolicy) g_value_get_enum (value);
+      break;
+    case PROP_SCHEDULING_PRIORITY:
+      siddecfp->sched_priority = g_value_get_int (value);
+      break;
+    case PROP_THREAD_NAME:
+      g_free (siddecfp->thread_name);
+      siddecfp->thread_name = g_value_dup_string (value);
+      break;
+    case PROP_SONGLENGTH_DB:
+      g_free (siddecfp->songlength_db);
+      siddecfp->songlength_db = g_value_dup_string (value);
+      break;
+    case PROP_SEEK_HISTORY:
+      settings->seek_history = g_value_get_uint64 (value);
+      break;
+    case PROP_ALL_SUBTUNES:
+      settings->all_subtunes = g_value_get_boolean (value);
+      siddecfp->settings_changed |= SIDDECFP_CHANGED_PLAYBACK;
+      break;
+    case PROP_MAX_LENGTH:
+      settings->max_length = g_value_get_uint64 (value);
+      siddecfp->settings_changed |= SIDDECFP_CHANGED_PLAYBACK;
+      break;
+    case PROP_SKIP_LEADING_SILENCE:
+      settings->skip_leading_silence = g_value_get_boolean (value);
+      siddecfp->settings_changed |= SIDDECFP_CHANGED_PLAYBACK;
+      break;
+    case PROP_SILENCE_THRESHOLD:
+      settings->silence_threshold = g_value_get_uint (value);
+      siddecfp->settings_changed |= SIDDECFP_CHANGED_SILENCE;
+      break;
+    case PROP_SILENCE_DURATION:
+      settings->silence_duration = g_value_get_uint64 (value);
+      siddecfp->settings_changed |= SIDDECFP_CHANGED_SILENCE;
+      break;
+    case PROP_LOOP_DETECTION:
+      settings->loop_detection = g_value_get_boolean (value);
+      siddecfp->settings_changed |= SIDDECFP_CHANGED_PLAYBACK;
+      break;
+    case PROP_MAX_LOOPS:
+      siddecfp->max_loops = g_value_get_uint (value);
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
-      return;
+      break;
   }
-  siddecfp->player->config (siddecfp->config);
+  GST_OBJECT_UNLOCK (siddecfp);
 }
 
 static void
@@ -997,6 +4599,7 @@ gst_siddecfp_get_property (GObject * object, guint prop_id, GValue * value,
 {
   GstSidDecFp *siddecfp = GST_SIDDECFP (object);
 
+  GST_OBJECT_LOCK (siddecfp);
   switch (prop_id) {
     case PROP_EMULATION:
       g_value_set_enum (value, siddecfp->emulation);
@@ -1017,45 +4620,106 @@ gst_siddecfp_get_property (GObject * object, guint prop_id, GValue * value,
       g_value_set_boolean (value, siddecfp->filter);
       break;
     case PROP_C64_MODEL:
-      g_value_set_enum (value, siddecfp->config.defaultC64Model);
+      g_value_set_enum (value, siddecfp->settings.config.defaultC64Model);
       break;
     case PROP_SID_MODEL:
-      g_value_set_enum (value, siddecfp->config.defaultSidModel);
+      g_value_set_enum (value, siddecfp->settings.config.defaultSidModel);
       break;
     case PROP_CIA_MODEL:
-      g_value_set_enum (value, siddecfp->config.ciaModel);
+      g_value_set_enum (value, siddecfp->settings.config.ciaModel);
       break;
     case PROP_FORCE_SID_MODEL:
-      g_value_set_boolean (value, siddecfp->config.forceSidModel);
+      g_value_set_boolean (value, siddecfp->settings.config.forceSidModel);
       break;
     case PROP_FORCE_C64_MODEL:
-      g_value_set_boolean (value, siddecfp->config.forceC64Model);
+      g_value_set_boolean (value, siddecfp->settings.config.forceC64Model);
       break;
     case PROP_SAMPLING_METHOD:
-      g_value_set_enum (value, siddecfp->config.samplingMethod);
+      g_value_set_enum (value, siddecfp->settings.config.samplingMethod);
       break;
     case PROP_DIGI_BOOST:
-      g_value_set_boolean (value, siddecfp->config.digiBoost);
+      g_value_set_boolean (value, siddecfp->settings.config.digiBoost);
       break;
     case PROP_FILTER_CURVE_6581:
-      g_value_set_double (value, siddecfp->filter_curve_6581);
+      g_value_set_double (value, siddecfp->settings.filter_curve_6581);
       break;
     case PROP_FILTER_CURVE_8580:
-      g_value_set_double (value, siddecfp->filter_curve_8580);
+      g_value_set_double (value, siddecfp->settings.filter_curve_8580);
       break;
     case PROP_FILTER_BIAS:
-      g_value_set_double (value, siddecfp->filter_bias);
+      g_value_set_double (value, siddecfp->settings.filter_bias);
       break;
     case PROP_BLOCKSIZE:
-      g_value_set_uint (value, siddecfp->blocksize);
+      g_value_set_uint (value, siddecfp->settings.blocksize);
+      break;
+    case PROP_AB_SID_MODEL:
+      g_value_set_enum (value, siddecfp->ab_sid_model);
+      break;
+    case PROP_REGISTER_LOG:
+      g_value_set_string (value, siddecfp->register_log);
+      break;
+    case PROP_RENDER_AHEAD:
+      g_value_set_uint (value, siddecfp->settings.render_ahead);
+      break;
+    case PROP_SHARED_SCHEDULER:
+      g_value_set_boolean (value, siddecfp->shared_scheduler);
+      break;
+    case PROP_OVER_BUDGET:
+      g_value_set_enum (value, siddecfp->over_budget);
+      break;
+    case PROP_COST:
+      g_value_set_double (value, siddecfp->cost);
+      break;
+    case PROP_CPU_AFFINITY:
+      g_value_set_string (value, siddecfp->cpu_affinity);
+      break;
+    case PROP_SCHEDULING_POLICY:
+      g_value_set_enum (value, siddecfp->sched_policy);
+      break;
+    case PROP_SCHEDULING_PRIORITY:
+      g_value_set_int (value, siddecfp->sched_priority);
+      break;
+    case PROP_THREAD_NAME:
+      g_value_set_string (value, siddecfp->thread_name);
+      break;
+    case PROP_SONGLENGTH_DB:
+      g_value_set_string (value, siddecfp->songlength_db);
+      break;
+    case PROP_SEEK_HISTORY:
+      g_value_set_uint64 (value, siddecfp->settings.seek_history);
+      break;
+    case PROP_ALL_SUBTUNES:
+      g_value_set_boolean (value, siddecfp->settings.all_subtunes);
+      break;
+    case PROP_MAX_LENGTH:
+      g_value_set_uint64 (value, siddecfp->settings.max_length);
+      break;
+    case PROP_SKIP_LEADING_SILENCE:
+      g_value_set_boolean (value, siddecfp->settings.skip_leading_silence);
+      break;
+    case PROP_SILENCE_THRESHOLD:
+      g_value_set_uint (value, siddecfp->settings.silence_threshold);
+      break;
+    case PROP_SILENCE_DURATION:
+      g_value_set_uint64 (value, siddecfp->settings.silence_duration);
+      break;
+    case PROP_LOOP_DETECTION:
+      g_value_set_boolean (value, siddecfp->settings.loop_detection);
+      break;
+    case PROP_MAX_LOOPS:
+      g_value_set_uint (value, siddecfp->max_loops);
       break;
     case PROP_METADATA:
       g_value_set_boxed (value, NULL);
       break;
+    case PROP_ENGINE_POOL_STATS:
+      g_value_take_boxed (value, gst_siddecfp_engine_pool_get_stats ());
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
+  GST_OBJECT_UNLOCK (siddecfp);
 }
 
 static gboolean
@@ -29,13 +29,78 @@
 
 #include <gst/gst.h>
 
+#include "gstsidloop.h"
+#include "gstsidreglog.h"
+#include "gstsidsonglength.h"
+
 G_BEGIN_DECLS
 
 typedef enum {
     SIDDECFP_EMULATION_RESIDFP,
     SIDDECFP_EMULATION_RESID,
+    SIDDECFP_EMULATION_NULL,
+    SIDDECFP_EMULATION_PREVIEW,
 } SidDecFpEmulation;
 
+typedef enum {
+    SIDDECFP_SCHED_OTHER,
+    SIDDECFP_SCHED_FIFO,
+    SIDDECFP_SCHED_RR,
+} SidDecFpSchedPolicy;
+
+typedef enum {
+    SIDDECFP_OVER_BUDGET_PLAY,
+    SIDDECFP_OVER_BUDGET_REFUSE,
+    SIDDECFP_OVER_BUDGET_DOWNGRADE,
+} SidDecFpOverBudget;
+
+typedef enum {
+    SIDDECFP_AB_NONE,
+    SIDDECFP_AB_MOS6581,
+    SIDDECFP_AB_MOS8580,
+} SidDecFpAbModel;
+
+/* parts of the settings changed since they were last applied */
+typedef enum {
+    SIDDECFP_CHANGED_CONFIG    = (1 << 0),
+    SIDDECFP_CHANGED_FILTER    = (1 << 1),
+    SIDDECFP_CHANGED_BLOCKSIZE = (1 << 2),
+    SIDDECFP_CHANGED_RATE      = (1 << 3),
+    SIDDECFP_CHANGED_SILENCE   = (1 << 4),
+    SIDDECFP_CHANGED_PLAYBACK  = (1 << 5),
+} SidDecFpChanged;
+
+/* the properties the streaming thread picks up between blocks */
+typedef struct _SidDecFpSettings SidDecFpSettings;
+
+struct _SidDecFpSettings {
+  SidConfig     config;         /* frequency, playback and sidEmulation unused */
+  gdouble       filter_curve_6581;
+  gdouble       filter_curve_8580;
+  gdouble       filter_bias;
+  guint         blocksize;
+  gdouble       rate;           /* from seeks */
+  guint         silence_threshold;
+  GstClockTime  silence_duration;
+  GstClockTime  max_length;
+  gboolean      skip_leading_silence;
+  gboolean      all_subtunes;
+  gboolean      loop_detection;
+  GstClockTime  seek_history;   /* taken by play_loop for each block */
+  guint         render_ahead;   /* taken when rendering ahead starts */
+};
+
+/* everything that makes one sid builder different from another */
+typedef struct _SidDecFpBuilderKey SidDecFpBuilderKey;
+
+struct _SidDecFpBuilderKey {
+  SidDecFpEmulation emulation;
+  guint             sids;
+  gdouble           filter_curve_6581;
+  gdouble           filter_curve_8580;
+  gdouble           filter_bias;
+};
+
 
 #define GST_TYPE_SIDDECFP \
   (gst_siddecfp_get_type())
@@ -51,6 +116,31 @@ typedef enum {
 typedef struct _GstSidDecFp GstSidDecFp;
 typedef struct _GstSidDecFpClass GstSidDecFpClass;
 
+/* a subtune rendered on a src_%u request pad, by an own engine */
+typedef struct _SidDecFpSubtunePad SidDecFpSubtunePad;
+
+struct _SidDecFpSubtunePad {
+  GstSidDecFp   *siddecfp;
+  GstPad        *pad;
+  guint         song;           /* counting from 1 */
+  sidplayfp     *player;
+  SidConfig     config;
+  sidbuilder    *builder;
+  SidDecFpBuilderKey builder_key;
+  gdouble       cost;           /* reserved from the budget, in cores */
+  guint         channels;
+  gboolean      started;        /* the subtune is loaded and announced */
+  guint64       total_bytes;
+  guint64       time_ms;        /* emulated, without SID emulation */
+  guint64       null_frames;    /* silence owed, without SID emulation */
+  guint64       silent_bytes;
+  GstClockTime  length;         /* NONE if unknown */
+  /* settings when the subtune started */
+  guint         blocksize;
+  guint         silence_threshold;
+  GstClockTime  silence_duration;
+};
+
 struct _GstSidDecFp {
   GstElement     element;
 
@@ -63,23 +153,120 @@ struct _GstSidDecFp {
 
   guchar        *tune_buffer;
   gint           tune_len;
+  GQueue         pending_tunes;   /* complete tunes as GBytes, LOCK */
   gint           tune_number;
+  GMutex         tune_lock;     /* selecting and loading songs of tune */
+  guint          song;          /* the player's subtune, tune_lock */
+  GList          *subtune_pads; /* SidDecFpSubtunePad, LOCK */
   guint64        total_bytes;
+  guint64        rendered_bytes; /* of the player, ahead of total_bytes */
+  GstClockTime   tune_start_time; /* stream time the current tune started at */
+  GstClockTime   lead_in;        /* silence skipped at its start, tune time */
+  gboolean       skip_leading_silence;
+  gdouble        rate;           /* playback rate of the player */
+  GstSegment     segment;
+
+  /* the last rendered blocks, for backward seeks */
+  GstClockTime   seek_history;   /* how much to keep, 0 = none */
+  GQueue         history;        /* SidDecFpBlock, oldest first */
+  guint64        history_start;  /* stream bytes the oldest block starts at */
+  guint64        history_end;    /* where the player continues */
+
+  /* seeking, done by play_loop */
+  gboolean       seeking;
+  gboolean       seek_started;
+  GstClockTime   seek_target;    /* stream time */
+  guint64        seek_from_ms;   /* tune time the skip started at */
+  gint           seek_percent;   /* last posted progress, -1 = none */
+  guint32        seek_seqnum;
+  guint64        tune_time_ms;   /* emulated time of the current tune */
+  guint64        null_frames;    /* silence owed with emulation=null */
+  guint64        null_rest;      /* of the time scaled to null_frames */
 
   SidDecFpEmulation emulation;
+  SidDecFpEmulation emulation_in_use; /* differs when downgraded */
   sidplayfp     *player;
   SidTune       *tune;
   SidConfig     config;
   sidbuilder    *builder;
+  SidDecFpBuilderKey builder_key;
+  GThread       *prepare_thread;
   gboolean      filter;
   gdouble       filter_curve_6581;
   gdouble       filter_curve_8580;
   gdouble       filter_bias;
-  GByteArray    *kernal;
-  GByteArray    *basic;
-  GByteArray    *chargen;
+  GByteArray    *kernal;        /* LOCK */
+  GByteArray    *basic;         /* LOCK */
+  GByteArray    *chargen;       /* LOCK */
+
+  SidDecFpSettings settings;    /* as set by the properties, LOCK */
+  guint         settings_changed; /* SidDecFpChanged, LOCK */
 
   guint         blocksize;
+
+  gchar         *register_log;
+  SidRegLogWriter *reglog;
+
+  gchar         *songlength_db; /* LOCK */
+  SidSongLengthDb *songlengths;
+  gchar         md5[33];        /* of the current tune, for songlengths */
+  gchar         md5_old[33];    /* the same by libsidplayfp's old method */
+  GstClockTime  song_length;    /* of the current tune, NONE if unknown */
+  GstToc        *toc;           /* subtunes of the current tune, LOCK */
+  gboolean      all_subtunes;
+  GArray        *song_starts;   /* GstClockTime by subtune, all_subtunes */
+  GstClockTime  max_length;     /* 0 = none */
+
+  /* ending tunes that went silent or stopped */
+  guint         silence_threshold;
+  GstClockTime  silence_duration; /* 0 = disabled */
+  guint64       silent_bytes;   /* rendered since the last sound */
+  gboolean      stalled;        /* the player rendered less than asked */
+
+  /* loop detection */
+  gboolean      loop_detection;
+  guint         max_loops;      /* LOCK */
+  SidLoopDetector *loop_detector;
+  guint64       loop_base_bytes; /* rendered_bytes when detection started */
+  GstClockTime  loop_base_time; /* tune time when detection started */
+  GstClockTime  loop_start;     /* tune time, NONE until found */
+  GstClockTime  loop_period;
+
+  guint         channels;       /* of the output, not of the player */
+  SidDecFpAbModel ab_sid_model;
+  gboolean      ab_enabled;     /* stereo A/B output negotiated */
+  sidplayfp     *ab_player;     /* in lockstep with player */
+  sidbuilder    *ab_builder;
+  SidDecFpBuilderKey ab_builder_key;
+  gint16        *ab_scratch;    /* ab_scratch_len samples per player */
+  guint         ab_scratch_len;
+
+  /* render ahead buffering, on an own thread for multi SID tunes or on the
+   * shared scheduler */
+  guint         render_ahead;
+  gboolean      shared_scheduler;
+  gboolean      rendering_ahead;
+  GThread       *render_thread;
+  GMutex        render_lock;
+  GCond         render_cond;
+  GQueue        rendered;       /* SidDecFpBlock, render_lock */
+  guint64       rendered_queued_bytes; /* render_lock */
+  gboolean      render_stop;    /* render_lock */
+  gboolean      render_done;    /* render_lock */
+  gboolean      render_scheduled; /* job queued or running, render_lock */
+
+  /* tuning of the thread running the emulation, LOCK */
+  gchar         *cpu_affinity;
+  SidDecFpSchedPolicy sched_policy;
+  gint          sched_priority;
+  gchar         *thread_name;
+
+  /* admission control */
+  SidDecFpOverBudget over_budget;
+  gdouble       cost;           /* reserved from the budget, in cores */
+  gint64        render_time;    /* spent rendering, until calibrated */
+  guint64       calibration_bytes; /* rendered when the tune was admitted */
+  gboolean      calibrated;
 };
 
 struct _GstSidDecFpClass {
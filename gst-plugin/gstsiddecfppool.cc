@@ -0,0 +1,603 @@
+/* GStreamer
+ * Copyright (C) <2022> Joni Valtanen <jvaltane@kapsi.fi>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Creating a ReSIDfp or ReSID builder builds all of its chip emulations
+ * (and their filter and waveform tables), which is by far the most
+ * expensive part of starting a tune. Builders are therefore never deleted
+ * when a tune ends but handed back to this process wide pool, and the next
+ * element asking for the same emulation gets one that is already built.
+ *
+ * A builder is owned by one sidplayfp at a time: filter settings apply to
+ * every chip of a builder, so sharing one between players is not possible.
+ *
+ * The sidplayfp engines themselves are pooled too. Elements check one out
+ * when going to READY and return it when going back to NULL. The pool is
+ * configured with environment variables:
+ *
+ *   GST_SIDDECFP_POOL_SIZE     maximum number of engines, 0 (the default)
+ *                              is unbounded
+ *   GST_SIDDECFP_POOL_WARMUP   engines to construct on first use
+ *   GST_SIDDECFP_POOL_TIMEOUT  milliseconds to wait for a free engine
+ *
+ * Elements going to READY do not wait for an engine, the state change
+ * fails at once when the pool is exhausted. Only the engines taken while
+ * streaming, for A/B renders and subtune pads, wait up to the timeout.
+ *
+ * Elements using the shared scheduler do not render on their own threads.
+ * They queue render jobs to one process wide thread pool instead, which
+ * runs the job with the earliest deadline first. Its size is set with
+ * GST_SIDDECFP_SCHEDULER_THREADS, by default one thread per CPU.
+ *
+ * Admission control keeps track of the CPU time the playing decoders are
+ * expected to need. The cost of a tune is estimated from its header and
+ * the output format with a simple model, in CPU cores at realtime. The
+ * model is calibrated per emulation by measuring how long the first second
+ * of every tune takes to render. GST_SIDDECFP_BUDGET limits the total, in
+ * percent of one core, 0 (the default) is unlimited.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <sidplayfp/builders/resid.h>
+#include <sidplayfp/builders/residfp.h>
+
+#include "gstsiddecfppool.h"
+
+GST_DEBUG_CATEGORY_EXTERN (gst_siddecfp_debug);
+#define GST_CAT_DEFAULT gst_siddecfp_debug
+
+/* idle builders kept around, further released builders are deleted */
+#define MAX_IDLE_BUILDERS 8
+
+#define DEFAULT_POOL_SIZE 0
+#define DEFAULT_POOL_WARMUP 0
+#define DEFAULT_POOL_TIMEOUT 5000
+#define DEFAULT_BUDGET 0
+
+typedef struct {
+  SidDecFpBuilderKey key;
+  sidbuilder        *builder;
+} IdleBuilder;
+
+static GMutex builder_pool_lock;
+static GList *idle_builders = NULL;     /* of IdleBuilder, builder_pool_lock */
+
+static gboolean
+is_sidbuilder_valid (sidbuilder *builder)
+{
+    if (builder == NULL) return FALSE;
+    if (!builder->getStatus ()) return FALSE;
+    return TRUE;
+}
+
+static gboolean
+key_equal (const SidDecFpBuilderKey * a, const SidDecFpBuilderKey * b)
+{
+  return a->emulation == b->emulation && a->sids == b->sids &&
+      a->filter_curve_6581 == b->filter_curve_6581 &&
+      a->filter_curve_8580 == b->filter_curve_8580 &&
+      a->filter_bias == b->filter_bias;
+}
+
+static sidbuilder *
+new_builder (const SidDecFpBuilderKey * key)
+{
+  sidbuilder *builder;
+
+  if (key->emulation == SIDDECFP_EMULATION_RESIDFP) {
+    builder = new ReSIDfpBuilder ("ReSIDfp");
+  } else if (key->emulation == SIDDECFP_EMULATION_RESID) {
+    builder = new ReSIDBuilder ("ReSID");
+  } else if (key->emulation == SIDDECFP_EMULATION_PREVIEW) {
+    builder = new ReSIDBuilder ("ReSID preview");
+  } else {
+    return NULL;
+  }
+
+  if (!is_sidbuilder_valid (builder))
+    goto invalid;
+
+  builder->create (key->sids);
+  if (!is_sidbuilder_valid (builder))
+    goto invalid;
+
+  builder->filter (false);
+  if (!is_sidbuilder_valid (builder))
+    goto invalid;
+
+  GST_DEBUG ("created %s builder with %u sids", builder->name (), key->sids);
+
+  return builder;
+
+invalid:
+  GST_WARNING ("could not create builder: %s", builder->error ());
+  delete builder;
+  return NULL;
+}
+
+/* applies the parameters that differ between @have and @want */
+gboolean
+gst_siddecfp_builder_configure (sidbuilder * builder, SidDecFpBuilderKey * have,
+    const SidDecFpBuilderKey * want)
+{
+  if (have->emulation != want->emulation || have->sids != want->sids)
+    return FALSE;
+
+  if (want->emulation == SIDDECFP_EMULATION_RESIDFP) {
+    ReSIDfpBuilder *rsfp = static_cast<ReSIDfpBuilder *> (builder);
+
+    if (have->filter_curve_6581 != want->filter_curve_6581)
+      rsfp->filter6581Curve (want->filter_curve_6581);
+    if (have->filter_curve_8580 != want->filter_curve_8580)
+      rsfp->filter8580Curve (want->filter_curve_8580);
+  } else if (want->emulation == SIDDECFP_EMULATION_RESID) {
+    ReSIDBuilder *rs = static_cast<ReSIDBuilder *> (builder);
+
+    if (have->filter_bias != want->filter_bias)
+      rs->bias (want->filter_bias);
+  }
+
+  *have = *want;
+
+  return is_sidbuilder_valid (builder);
+}
+
+/* Returns a builder configured as @key wants. An idle builder with exactly
+ * the same key is preferred, then one with the same emulation that only
+ * needs its filter settings changed, and only then a new one is built. */
+sidbuilder *
+gst_siddecfp_builder_pool_acquire (const SidDecFpBuilderKey * key)
+{
+  IdleBuilder *idle = NULL;
+  sidbuilder *builder;
+  SidDecFpBuilderKey have;
+  GList *l;
+
+  g_mutex_lock (&builder_pool_lock);
+  for (l = idle_builders; l != NULL; l = l->next) {
+    IdleBuilder *candidate = (IdleBuilder *) l->data;
+
+    if (candidate->key.emulation != key->emulation ||
+        candidate->key.sids != key->sids)
+      continue;
+    idle = candidate;
+    if (key_equal (&candidate->key, key))
+      break;
+  }
+  if (idle != NULL)
+    idle_builders = g_list_remove (idle_builders, idle);
+  g_mutex_unlock (&builder_pool_lock);
+
+  if (idle != NULL) {
+    builder = idle->builder;
+    have = idle->key;
+    g_free (idle);
+    GST_DEBUG ("reusing %s builder", builder->name ());
+  } else {
+    builder = new_builder (key);
+    if (builder == NULL)
+      return NULL;
+    /* force all parameters to be applied */
+    have = *key;
+    have.filter_curve_6581 = have.filter_curve_8580 = have.filter_bias = -G_MAXDOUBLE;
+  }
+
+  if (!gst_siddecfp_builder_configure (builder, &have, key)) {
+    delete builder;
+    return NULL;
+  }
+
+  return builder;
+}
+
+/* The builder must not be in use by any player anymore */
+void
+gst_siddecfp_builder_pool_release (sidbuilder * builder,
+    const SidDecFpBuilderKey * key)
+{
+  IdleBuilder *idle;
+
+  if (builder == NULL)
+    return;
+
+  g_mutex_lock (&builder_pool_lock);
+  if (g_list_length (idle_builders) < MAX_IDLE_BUILDERS) {
+    idle = g_new0 (IdleBuilder, 1);
+    idle->key = *key;
+    idle->builder = builder;
+    idle_builders = g_list_prepend (idle_builders, idle);
+    builder = NULL;
+  }
+  g_mutex_unlock (&builder_pool_lock);
+
+  delete builder;
+}
+
+typedef struct {
+  gboolean      initialized;
+  guint         size;
+  guint         warmup;
+  gint64        timeout;        /* in microseconds */
+
+  GMutex        lock;
+  GCond         cond;
+  GList        *idle;           /* of sidplayfp */
+  guint         created;
+
+  /* metrics */
+  guint64       checkouts;
+  guint64       exhausted;
+  guint64       timeouts;
+  GstClockTime  wait_time;
+  GstClockTime  max_wait_time;
+
+  /* admission control, in cores */
+  gdouble       budget;         /* 0 is unlimited */
+  gdouble       budget_used;
+  guint64       refused;
+  gdouble       calibration[SIDDECFP_EMULATION_PREVIEW + 1];
+} EnginePool;
+
+static EnginePool engine_pool;
+
+static guint
+env_uint (const gchar * name, guint def)
+{
+  const gchar *str = g_getenv (name);
+  gchar *end = NULL;
+  guint64 val;
+
+  if (str == NULL || *str == '\0')
+    return def;
+
+  val = g_ascii_strtoull (str, &end, 10);
+  if (*end != '\0' || val > G_MAXUINT) {
+    GST_WARNING ("ignoring invalid value '%s' for %s", str, name);
+    return def;
+  }
+  return (guint) val;
+}
+
+/* called with the pool lock */
+static void
+engine_pool_init_unlocked (void)
+{
+  guint i;
+
+  if (engine_pool.initialized)
+    return;
+
+  engine_pool.size = env_uint ("GST_SIDDECFP_POOL_SIZE", DEFAULT_POOL_SIZE);
+  engine_pool.warmup = env_uint ("GST_SIDDECFP_POOL_WARMUP", DEFAULT_POOL_WARMUP);
+  engine_pool.timeout = (gint64) env_uint ("GST_SIDDECFP_POOL_TIMEOUT",
+      DEFAULT_POOL_TIMEOUT) * G_TIME_SPAN_MILLISECOND;
+  if (engine_pool.size > 0 && engine_pool.warmup > engine_pool.size)
+    engine_pool.warmup = engine_pool.size;
+  engine_pool.budget = env_uint ("GST_SIDDECFP_BUDGET", DEFAULT_BUDGET) / 100.0;
+  for (i = 0; i < G_N_ELEMENTS (engine_pool.calibration); i++)
+    engine_pool.calibration[i] = 1.0;
+
+  GST_INFO ("engine pool size %u, warmup %u", engine_pool.size,
+      engine_pool.warmup);
+
+  for (i = 0; i < engine_pool.warmup; i++)
+    engine_pool.idle = g_list_prepend (engine_pool.idle, new sidplayfp ());
+  engine_pool.created = engine_pool.warmup;
+
+  engine_pool.initialized = TRUE;
+}
+
+/* Checks out an engine. When the pool is exhausted this returns NULL, or
+ * with @wait waits for another element to return one and gives up with
+ * NULL after the pool timeout. */
+sidplayfp *
+gst_siddecfp_engine_pool_acquire (gboolean wait)
+{
+  sidplayfp *engine = NULL;
+  gboolean create = FALSE;
+  gint64 start, end, waited;
+
+  g_mutex_lock (&engine_pool.lock);
+  engine_pool_init_unlocked ();
+
+  if (engine_pool.idle == NULL &&
+      (engine_pool.size == 0 || engine_pool.created < engine_pool.size)) {
+    engine_pool.created++;
+    create = TRUE;
+  } else if (engine_pool.idle == NULL) {
+    engine_pool.exhausted++;
+    if (!wait) {
+      g_mutex_unlock (&engine_pool.lock);
+      GST_WARNING ("engine pool exhausted");
+      return NULL;
+    }
+    GST_DEBUG ("engine pool exhausted, waiting");
+
+    start = g_get_monotonic_time ();
+    end = start + engine_pool.timeout;
+    while (engine_pool.idle == NULL) {
+      if (!g_cond_wait_until (&engine_pool.cond, &engine_pool.lock, end))
+        break;
+    }
+    waited = (g_get_monotonic_time () - start) * GST_USECOND;
+    engine_pool.wait_time += waited;
+    engine_pool.max_wait_time = MAX (engine_pool.max_wait_time,
+        (GstClockTime) waited);
+
+    if (engine_pool.idle == NULL) {
+      engine_pool.timeouts++;
+      g_mutex_unlock (&engine_pool.lock);
+      GST_WARNING ("no engine returned to the pool in time");
+      return NULL;
+    }
+  }
+
+  if (!create) {
+    engine = (sidplayfp *) engine_pool.idle->data;
+    engine_pool.idle = g_list_delete_link (engine_pool.idle, engine_pool.idle);
+  }
+  engine_pool.checkouts++;
+  g_mutex_unlock (&engine_pool.lock);
+
+  if (create)
+    engine = new sidplayfp ();
+
+  return engine;
+}
+
+/* The engine must not hold chips of any builder anymore */
+void
+gst_siddecfp_engine_pool_release (sidplayfp * engine)
+{
+  if (engine == NULL)
+    return;
+
+  /* the tune and the roms belong to the previous user */
+  engine->load (NULL);
+  engine->setRoms (NULL, NULL, NULL);
+
+  g_mutex_lock (&engine_pool.lock);
+  engine_pool.idle = g_list_prepend (engine_pool.idle, engine);
+  g_cond_signal (&engine_pool.cond);
+  g_mutex_unlock (&engine_pool.lock);
+}
+
+GstStructure *
+gst_siddecfp_engine_pool_get_stats (void)
+{
+  GstStructure *stats;
+  guint idle;
+
+  g_mutex_lock (&engine_pool.lock);
+  engine_pool_init_unlocked ();
+  idle = g_list_length (engine_pool.idle);
+  stats = gst_structure_new ("siddecfp-engine-pool",
+      "size", G_TYPE_UINT, engine_pool.size,
+      "created", G_TYPE_UINT, engine_pool.created,
+      "idle", G_TYPE_UINT, idle,
+      "in-use", G_TYPE_UINT, engine_pool.created - idle,
+      "checkouts", G_TYPE_UINT64, engine_pool.checkouts,
+      "exhausted", G_TYPE_UINT64, engine_pool.exhausted,
+      "timeouts", G_TYPE_UINT64, engine_pool.timeouts,
+      "wait-time", G_TYPE_UINT64, engine_pool.wait_time,
+      "max-wait-time", G_TYPE_UINT64, engine_pool.max_wait_time,
+      "budget", G_TYPE_DOUBLE, engine_pool.budget,
+      "budget-used", G_TYPE_DOUBLE, engine_pool.budget_used,
+      "refused", G_TYPE_UINT64, engine_pool.refused, NULL);
+  g_mutex_unlock (&engine_pool.lock);
+
+  return stats;
+}
+
+/* Guesses, not measurements, of the cores one SID chip needs at PAL
+ * clock. They are only starting points, the calibration scales them to
+ * the host. */
+static gdouble
+chip_cost (SidDecFpEmulation emulation, SidConfig::sampling_method_t method,
+    guint rate)
+{
+  switch (emulation) {
+    case SIDDECFP_EMULATION_RESIDFP:
+      /* the resampler runs a FIR filter per output sample */
+      if (method == SidConfig::RESAMPLE_INTERPOLATE)
+        return 0.04 + 0.03 * rate / 48000.0;
+      return 0.04;
+    case SIDDECFP_EMULATION_RESID:
+      if (method == SidConfig::RESAMPLE_INTERPOLATE)
+        return 0.02 + 0.02 * rate / 48000.0;
+      return 0.02;
+    case SIDDECFP_EMULATION_PREVIEW:
+      return 0.012;
+    case SIDDECFP_EMULATION_NULL:
+    default:
+      return 0.0;
+  }
+}
+
+/* Estimated cores needed to play a tune in realtime. @clock is the C64
+ * clock in Hz. */
+gdouble
+gst_siddecfp_cost_estimate (SidDecFpEmulation emulation, guint sids,
+    guint32 clock, SidConfig::sampling_method_t method, guint rate)
+{
+  gdouble cost, calibration;
+
+  /* the 6510 and the CIAs, which run even without SID emulation */
+  cost = 0.004 + sids * chip_cost (emulation, method, rate);
+  cost *= clock / 985248.0;
+
+  g_mutex_lock (&engine_pool.lock);
+  engine_pool_init_unlocked ();
+  calibration = engine_pool.calibration[emulation];
+  g_mutex_unlock (&engine_pool.lock);
+
+  return cost * calibration;
+}
+
+/* Feeds a measurement of a tune that was estimated to need @estimated
+ * cores, but needed @measured, back into the model of its emulation. */
+void
+gst_siddecfp_cost_calibrate (SidDecFpEmulation emulation, gdouble estimated,
+    gdouble measured)
+{
+  gdouble *calibration;
+
+  if (estimated <= 0.0 || measured <= 0.0)
+    return;
+
+  g_mutex_lock (&engine_pool.lock);
+  engine_pool_init_unlocked ();
+  calibration = &engine_pool.calibration[emulation];
+  /* @estimated includes the calibration it was made with */
+  *calibration = 0.75 * *calibration + 0.25 * *calibration * measured / estimated;
+  GST_DEBUG ("calibration of emulation %d now %f", emulation, *calibration);
+  g_mutex_unlock (&engine_pool.lock);
+}
+
+/* Reserves @cost cores of the budget. Returns FALSE if that would exceed
+ * the budget, unless @force is set. */
+gboolean
+gst_siddecfp_budget_reserve (gdouble cost, gboolean force)
+{
+  gboolean res = TRUE;
+
+  g_mutex_lock (&engine_pool.lock);
+  engine_pool_init_unlocked ();
+  if (!force && engine_pool.budget > 0 &&
+      engine_pool.budget_used + cost > engine_pool.budget) {
+    engine_pool.refused++;
+    res = FALSE;
+  } else {
+    engine_pool.budget_used += cost;
+  }
+  g_mutex_unlock (&engine_pool.lock);
+
+  return res;
+}
+
+void
+gst_siddecfp_budget_release (gdouble cost)
+{
+  g_mutex_lock (&engine_pool.lock);
+  engine_pool.budget_used = MAX (engine_pool.budget_used - cost, 0.0);
+  g_mutex_unlock (&engine_pool.lock);
+}
+
+/* Replaces a reservation of @old_cost with one of @cost in one step, so no
+ * other decoder can take the difference in between. On FALSE the old
+ * reservation stays. */
+gboolean
+gst_siddecfp_budget_replace (gdouble old_cost, gdouble cost, gboolean force)
+{
+  gdouble used;
+  gboolean res = TRUE;
+
+  g_mutex_lock (&engine_pool.lock);
+  engine_pool_init_unlocked ();
+  used = MAX (engine_pool.budget_used - old_cost, 0.0);
+  if (!force && engine_pool.budget > 0 && used + cost > engine_pool.budget) {
+    engine_pool.refused++;
+    res = FALSE;
+  } else {
+    engine_pool.budget_used = used + cost;
+  }
+  g_mutex_unlock (&engine_pool.lock);
+
+  return res;
+}
+
+typedef struct {
+  GstSidDecFpJobFunc func;
+  gpointer           data;
+  gint64             deadline;
+} RenderJob;
+
+static GThreadPool *scheduler;
+
+static gint
+compare_deadline (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+  const RenderJob *ja = (const RenderJob *) a;
+  const RenderJob *jb = (const RenderJob *) b;
+
+  return ja->deadline < jb->deadline ? -1 : ja->deadline > jb->deadline;
+}
+
+static void
+run_job (RenderJob * job, gpointer user_data)
+{
+  job->func (job->data);
+  g_free (job);
+}
+
+static gpointer
+scheduler_init (gpointer data)
+{
+  GThreadPool *pool;
+  GError *err = NULL;
+  guint threads;
+
+  threads = env_uint ("GST_SIDDECFP_SCHEDULER_THREADS",
+      g_get_num_processors ());
+  if (threads == 0)
+    threads = 1;
+
+  pool = g_thread_pool_new ((GFunc) run_job, NULL, threads, TRUE, &err);
+  if (pool == NULL) {
+    GST_WARNING ("could not create scheduler: %s", err->message);
+    g_error_free (err);
+    return NULL;
+  }
+  g_thread_pool_set_sort_function (pool, compare_deadline, NULL);
+
+  GST_INFO ("scheduler with %u threads", threads);
+
+  return pool;
+}
+
+/* Creates the shared scheduler on first use. Returns FALSE when it is not
+ * available and elements have to render on their own threads. */
+gboolean
+gst_siddecfp_scheduler_init (void)
+{
+  static GOnce once = G_ONCE_INIT;
+
+  scheduler = (GThreadPool *) g_once (&once, scheduler_init, NULL);
+
+  return scheduler != NULL;
+}
+
+/* Queues @func to be called with @data on a scheduler thread. Jobs with an
+ * earlier @deadline, in monotonic time, are run first. */
+void
+gst_siddecfp_scheduler_push (GstSidDecFpJobFunc func, gpointer data,
+    gint64 deadline)
+{
+  RenderJob *job;
+
+  job = g_new (RenderJob, 1);
+  job->func = func;
+  job->data = data;
+  job->deadline = deadline;
+
+  g_thread_pool_push (scheduler, job, NULL);
+}
@@ -0,0 +1,60 @@
+/* GStreamer
+ * Copyright (C) <2022> Joni Valtanen <jvaltane@kapsi.fi>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef __GST_SIDDECFP_POOL_H__
+#define __GST_SIDDECFP_POOL_H__
+
+#include "gstsiddecfp.h"
+
+G_BEGIN_DECLS
+
+sidbuilder *gst_siddecfp_builder_pool_acquire (const SidDecFpBuilderKey * key);
+void        gst_siddecfp_builder_pool_release (sidbuilder * builder,
+                                               const SidDecFpBuilderKey * key);
+gboolean    gst_siddecfp_builder_configure    (sidbuilder * builder,
+                                               SidDecFpBuilderKey * have,
+                                               const SidDecFpBuilderKey * want);
+
+sidplayfp  *gst_siddecfp_engine_pool_acquire   (gboolean wait);
+void        gst_siddecfp_engine_pool_release   (sidplayfp * engine);
+GstStructure *gst_siddecfp_engine_pool_get_stats (void);
+
+gdouble     gst_siddecfp_cost_estimate        (SidDecFpEmulation emulation,
+                                               guint sids, guint32 clock,
+                                               SidConfig::sampling_method_t method,
+                                               guint rate);
+void        gst_siddecfp_cost_calibrate       (SidDecFpEmulation emulation,
+                                               gdouble estimated,
+                                               gdouble measured);
+gboolean    gst_siddecfp_budget_reserve       (gdouble cost, gboolean force);
+void        gst_siddecfp_budget_release       (gdouble cost);
+gboolean    gst_siddecfp_budget_replace       (gdouble old_cost, gdouble cost,
+                                               gboolean force);
+
+typedef void (*GstSidDecFpJobFunc) (gpointer data);
+
+gboolean    gst_siddecfp_scheduler_init       (void);
+void        gst_siddecfp_scheduler_push       (GstSidDecFpJobFunc func,
+                                               gpointer data,
+                                               gint64 deadline);
+
+G_END_DECLS
+
+#endif /* __GST_SIDDECFP_POOL_H__ */
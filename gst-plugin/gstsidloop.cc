@@ -0,0 +1,202 @@
+/* GStreamer
+ * Copyright (C) <2022> Joni Valtanen <jvaltane@kapsi.fi>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "gstsidloop.h"
+
+#define FNV_OFFSET G_GUINT64_CONSTANT (0xcbf29ce484222325)
+#define FNV_PRIME  G_GUINT64_CONSTANT (0x100000001b3)
+
+/* multiplier of the rolling hash, odd */
+#define ROLL_BASE  G_GUINT64_CONSTANT (0x9e3779b97f4a7c15)
+
+/* hashes of windows seen and the frame states are kept for at most this
+ * many frames, about an hour and 1.4 MB, tunes looping later than that
+ * are taken as not looping */
+#define MAX_FRAMES (50 * 60 * 60)
+
+typedef struct {
+  guint64      state;
+  GstClockTime time;
+  gboolean     changed;         /* differs from the frame before */
+} Frame;
+
+typedef struct {
+  guint64      hash;            /* first, the key of the table */
+  guint        end_frame;       /* frames pushed up to its end */
+  GstClockTime start;
+  GstClockTime end;
+} Window;
+
+struct _SidLoopDetector {
+  guint        window;
+  guint        min_changes;
+  guint64      base_pow;        /* ROLL_BASE ^ window */
+
+  Frame       *frames;          /* ring of the last window frames */
+  guint        pos;
+  guint        filled;
+  guint        changes;         /* changed frames in the ring */
+  guint64      hash;            /* rolling hash of the ring */
+  guint64      last_state;
+  guint64      seen;            /* frames pushed */
+  GstClockTime before;          /* end of the frame before the ring */
+  GArray      *states;          /* guint64 state of every frame pushed */
+  GHashTable  *windows;         /* Window by hash */
+};
+
+/* FNV-1a, continue from @hash or start with 0 */
+guint64
+sid_loop_hash_registers (guint64 hash, const guint8 * regs, gsize size)
+{
+  gsize i;
+
+  if (hash == 0)
+    hash = FNV_OFFSET;
+  for (i = 0; i < size; i++) {
+    hash ^= regs[i];
+    hash *= FNV_PRIME;
+  }
+
+  return hash;
+}
+
+SidLoopDetector *
+sid_loop_detector_new (guint window, guint min_changes)
+{
+  SidLoopDetector *detector;
+  guint i;
+
+  g_return_val_if_fail (window > 0, NULL);
+
+  detector = g_new0 (SidLoopDetector, 1);
+  detector->window = window;
+  detector->min_changes = min_changes;
+  detector->base_pow = 1;
+  for (i = 0; i < window; i++)
+    detector->base_pow *= ROLL_BASE;
+  detector->frames = g_new0 (Frame, window);
+  detector->states = g_array_new (FALSE, FALSE, sizeof (guint64));
+  detector->windows = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+      g_free, NULL);
+
+  return detector;
+}
+
+/* forgets everything, for when the tune restarts or jumps to @time */
+void
+sid_loop_detector_reset (SidLoopDetector * detector, GstClockTime time)
+{
+  detector->pos = 0;
+  detector->filled = 0;
+  detector->changes = 0;
+  detector->hash = 0;
+  detector->last_state = 0;
+  detector->seen = 0;
+  detector->before = time;
+  g_array_set_size (detector->states, 0);
+  g_hash_table_remove_all (detector->windows);
+}
+
+/* TRUE when the states of the window ending after @end_frame frames are
+ * the states of the last window */
+static gboolean
+same_window (SidLoopDetector * detector, guint end_frame)
+{
+  const guint64 *states = (const guint64 *) detector->states->data;
+  guint len = detector->states->len;
+
+  return memcmp (states + end_frame - detector->window,
+      states + len - detector->window,
+      detector->window * sizeof (guint64)) == 0;
+}
+
+/* Adds the state of the frame ending at @time. Returns TRUE when the last
+ * window was seen before, with the start of the loop and its period. */
+gboolean
+sid_loop_detector_push (SidLoopDetector * detector, guint64 state,
+    GstClockTime time, GstClockTime * start, GstClockTime * period)
+{
+  Frame *frame = &detector->frames[detector->pos];
+  Window *window;
+
+  if (detector->seen++ >= MAX_FRAMES)
+    return FALSE;
+
+  detector->hash = detector->hash * ROLL_BASE + state;
+  if (detector->filled == detector->window) {
+    /* drop the oldest frame, it is overwritten below */
+    detector->hash -= frame->state * detector->base_pow;
+    if (frame->changed)
+      detector->changes--;
+    detector->before = frame->time;
+  } else {
+    detector->filled++;
+  }
+
+  frame->state = state;
+  frame->time = time;
+  frame->changed = detector->seen > 1 && state != detector->last_state;
+  if (frame->changed)
+    detector->changes++;
+  detector->last_state = state;
+  detector->pos = (detector->pos + 1) % detector->window;
+  g_array_append_val (detector->states, state);
+
+  if (detector->filled < detector->window ||
+      detector->changes < detector->min_changes)
+    return FALSE;
+
+  /* equal hashes only make a loop when the windows are equal too, a
+   * window that collided with another one is not remembered */
+  window = (Window *) g_hash_table_lookup (detector->windows, &detector->hash);
+  if (window != NULL) {
+    if (!same_window (detector, window->end_frame))
+      return FALSE;
+    *start = window->start;
+    *period = time - window->end;
+    return TRUE;
+  }
+
+  window = g_new (Window, 1);
+  window->hash = detector->hash;
+  window->end_frame = detector->states->len;
+  window->start = detector->before;
+  window->end = time;
+  g_hash_table_insert (detector->windows, window, window);
+
+  return FALSE;
+}
+
+void
+sid_loop_detector_free (SidLoopDetector * detector)
+{
+  if (detector == NULL)
+    return;
+
+  g_hash_table_unref (detector->windows);
+  g_array_free (detector->states, TRUE);
+  g_free (detector->frames);
+  g_free (detector);
+}
@@ -0,0 +1,57 @@
+/* GStreamer
+ * Copyright (C) <2022> Joni Valtanen <jvaltane@kapsi.fi>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef __GST_SIDLOOP_H__
+#define __GST_SIDLOOP_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Finds the point where a tune starts over. The SID register state is
+ * hashed once per C64 frame and the hashes of the last window of frames
+ * are combined into a rolling hash. When a window seen before recurs, the
+ * music between the two is taken as one period of the loop. The states of
+ * all frames are kept, so a recurring hash is only taken as a loop when
+ * the states of the two windows are equal as well.
+ *
+ * A single state recurs all the time, e.g. on held notes, so only windows
+ * long enough to contain a stretch of music count, and windows with hardly
+ * any register changes in them are ignored.
+ */
+
+typedef struct _SidLoopDetector SidLoopDetector;
+
+SidLoopDetector *sid_loop_detector_new   (guint window, guint min_changes);
+void             sid_loop_detector_reset (SidLoopDetector * detector,
+                                          GstClockTime time);
+gboolean         sid_loop_detector_push  (SidLoopDetector * detector,
+                                          guint64 state, GstClockTime time,
+                                          GstClockTime * start,
+                                          GstClockTime * period);
+void             sid_loop_detector_free  (SidLoopDetector * detector);
+
+guint64          sid_loop_hash_registers (guint64 hash, const guint8 * regs,
+                                          gsize size);
+
+G_END_DECLS
+
+#endif /* __GST_SIDLOOP_H__ */
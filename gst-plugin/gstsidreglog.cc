@@ -0,0 +1,124 @@
+/* GStreamer
+ * Copyright (C) <2022> Joni Valtanen <jvaltane@kapsi.fi>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "gstsidreglog.h"
+
+struct _SidRegLogWriter {
+  FILE     *file;
+  guint64   last_cycle;
+  guint8    regs[SID_REG_LOG_MAX_CHIPS][SID_REG_LOG_REGS];
+  gboolean  valid[SID_REG_LOG_MAX_CHIPS];
+};
+
+static void
+put_uint32_le (guint8 * data, guint32 val)
+{
+  data[0] = val & 0xff;
+  data[1] = (val >> 8) & 0xff;
+  data[2] = (val >> 16) & 0xff;
+  data[3] = (val >> 24) & 0xff;
+}
+
+SidRegLogWriter *
+sid_reg_log_writer_new (const gchar * location, guint32 clock, guint chips,
+    GError ** error)
+{
+  SidRegLogWriter *writer;
+  guint8 header[SID_REG_LOG_HEADER_SIZE] = { 0, };
+  FILE *file;
+
+  file = g_fopen (location, "wb");
+  if (file == NULL) {
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+        "Could not open %s for writing: %s", location, g_strerror (errno));
+    return NULL;
+  }
+
+  memcpy (header, SID_REG_LOG_MAGIC, 8);
+  put_uint32_le (header + 8, clock);
+  header[12] = MIN (chips, SID_REG_LOG_MAX_CHIPS);
+
+  if (fwrite (header, sizeof (header), 1, file) != 1) {
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+        "Could not write %s: %s", location, g_strerror (errno));
+    fclose (file);
+    return NULL;
+  }
+
+  writer = g_new0 (SidRegLogWriter, 1);
+  writer->file = file;
+
+  return writer;
+}
+
+/* writes the registers that changed since the previous snapshot of @chip */
+void
+sid_reg_log_writer_snapshot (SidRegLogWriter * writer, guint64 cycle,
+    guint chip, const guint8 * regs)
+{
+  guint8 record[10 + 2];
+  guint64 delta;
+  guint i, len;
+
+  g_return_if_fail (chip < SID_REG_LOG_MAX_CHIPS);
+
+  for (i = 0; i < SID_REG_LOG_REGS; i++) {
+    if (writer->valid[chip] && writer->regs[chip][i] == regs[i])
+      continue;
+
+    /* the position may jump back, e.g. when seeking */
+    delta = cycle > writer->last_cycle ? cycle - writer->last_cycle : 0;
+    writer->last_cycle = cycle;
+
+    len = 0;
+    do {
+      record[len] = delta & 0x7f;
+      delta >>= 7;
+      if (delta != 0)
+        record[len] |= 0x80;
+      len++;
+    } while (delta != 0);
+    record[len++] = (chip << 5) | i;
+    record[len++] = regs[i];
+
+    fwrite (record, len, 1, writer->file);
+  }
+
+  memcpy (writer->regs[chip], regs, SID_REG_LOG_REGS);
+  writer->valid[chip] = TRUE;
+}
+
+void
+sid_reg_log_writer_free (SidRegLogWriter * writer)
+{
+  if (writer == NULL)
+    return;
+
+  fclose (writer->file);
+  g_free (writer);
+}
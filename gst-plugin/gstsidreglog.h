@@ -0,0 +1,67 @@
+/* GStreamer
+ * Copyright (C) <2022> Joni Valtanen <jvaltane@kapsi.fi>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef __GST_SIDREGLOG_H__
+#define __GST_SIDREGLOG_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * SID register log format, all numbers little endian:
+ *
+ *   header  "SIDREGS" 0x01     magic and version
+ *           guint32            C64 clock frequency in Hz
+ *           guint8             number of chips
+ *           guint8[3]          reserved, zero
+ *
+ *   record  varint             cycles since the previous record
+ *           guint8             chip << 5 | register
+ *           guint8             value
+ *
+ * varints use 7 bits per byte, least significant group first, with the
+ * high bit set on all but the last byte.
+ *
+ * The records are not the writes the tune made. libsidplayfp has no hook
+ * for SID writes, so the writer diffs a snapshot of the registers taken
+ * once per C64 frame against the previous one. All records of a frame
+ * carry the cycle of its end, and writes overwritten within the frame
+ * (hard restarts, pulse width modulation, digis) do not appear at all.
+ */
+
+#define SID_REG_LOG_MAGIC       "SIDREGS\001"
+#define SID_REG_LOG_HEADER_SIZE 16
+#define SID_REG_LOG_MAX_CHIPS   3
+#define SID_REG_LOG_REGS        25      /* writable registers $00-$18 */
+
+typedef struct _SidRegLogWriter SidRegLogWriter;
+
+SidRegLogWriter *sid_reg_log_writer_new      (const gchar * location,
+                                              guint32 clock, guint chips,
+                                              GError ** error);
+void             sid_reg_log_writer_snapshot (SidRegLogWriter * writer,
+                                              guint64 cycle, guint chip,
+                                              const guint8 * regs);
+void             sid_reg_log_writer_free     (SidRegLogWriter * writer);
+
+G_END_DECLS
+
+#endif /* __GST_SIDREGLOG_H__ */
@@ -0,0 +1,398 @@
+/* GStreamer
+ * Copyright (C) <2022> Joni Valtanen <jvaltane@kapsi.fi>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
+#include "gstsidsonglength.h"
+
+#define BYTE_ORDER_MARK 0x01020304
+
+struct _SidSongLengthDb {
+  gchar       *location;
+  gint         ref_count;         /* dbs_lock */
+
+  GMappedFile *mapped;            /* the index, or */
+  gchar       *compiled;          /* when it could not be cached */
+  const guint8 *slots;
+  guint32      n_slots;
+  const guint32 *lengths;
+  guint32      n_lengths;
+};
+
+/* opened databases by location, shared by all elements */
+static GMutex dbs_lock;
+static GHashTable *dbs = NULL;
+
+typedef struct {
+  guint8  md5[16];
+  guint32 first;
+  guint32 songs;
+} Slot;
+
+static gboolean
+parse_md5 (const gchar * str, guint8 * md5)
+{
+  guint i;
+
+  for (i = 0; i < 32; i++) {
+    if (!g_ascii_isxdigit (str[i]))
+      return FALSE;
+  }
+  for (i = 0; i < 16; i++)
+    md5[i] = (g_ascii_xdigit_value (str[2 * i]) << 4) |
+        g_ascii_xdigit_value (str[2 * i + 1]);
+
+  return TRUE;
+}
+
+/* parses "m:ss" or "m:ss.mmm", optionally followed by an attribute in
+ * parentheses as older databases have */
+static guint32
+parse_length (const gchar * str)
+{
+  guint64 min, sec, ms = 0;
+  gchar *end;
+  guint digits;
+
+  min = g_ascii_strtoull (str, &end, 10);
+  if (end == str || *end != ':')
+    return 0;
+  str = end + 1;
+  sec = g_ascii_strtoull (str, &end, 10);
+  if (end == str)
+    return 0;
+  if (*end == '.') {
+    str = end + 1;
+    ms = g_ascii_strtoull (str, &end, 10);
+    for (digits = end - str; digits < 3; digits++)
+      ms *= 10;
+    for (; digits > 3; digits--)
+      ms /= 10;
+  }
+
+  return MIN ((min * 60 + sec) * 1000 + ms, G_MAXUINT32);
+}
+
+static guint32
+slot_hash (const guint8 * md5)
+{
+  return md5[0] | (md5[1] << 8) | (md5[2] << 16) | ((guint32) md5[3] << 24);
+}
+
+/* compiles the text database into the index format */
+static gchar *
+compile (const gchar * text, const GStatBuf * st, gsize * size)
+{
+  GArray *slots, *lengths;
+  gchar **lines, *index, *end;
+  guint32 header[4], n_slots, i, h;
+  guint64 stamp[2];
+  Slot slot, *table;
+  gchar **times;
+  guint j;
+
+  slots = g_array_new (FALSE, FALSE, sizeof (Slot));
+  lengths = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+  lines = g_strsplit (text, "\n", -1);
+  for (i = 0; lines[i] != NULL; i++) {
+    gchar *line = g_strstrip (lines[i]);
+
+    /* section headers and the comments naming the file */
+    if (line[0] == '[' || line[0] == ';' || line[0] == '\0')
+      continue;
+    if (strlen (line) < 33 || line[32] != '=' || !parse_md5 (line, slot.md5))
+      continue;
+
+    slot.first = lengths->len;
+    times = g_strsplit (line + 33, " ", -1);
+    for (j = 0; times[j] != NULL; j++) {
+      guint32 ms;
+
+      if (times[j][0] == '\0')
+        continue;
+      ms = parse_length (times[j]);
+      g_array_append_val (lengths, ms);
+    }
+    g_strfreev (times);
+    slot.songs = lengths->len - slot.first;
+    if (slot.songs > 0)
+      g_array_append_val (slots, slot);
+  }
+  g_strfreev (lines);
+
+  /* keep the table at most half full */
+  for (n_slots = 16; n_slots < slots->len * 2; n_slots <<= 1);
+
+  *size = SID_SONG_LENGTH_HEADER_SIZE + n_slots * SID_SONG_LENGTH_SLOT_SIZE +
+      lengths->len * sizeof (guint32);
+  index = (gchar *) g_malloc0 (*size);
+
+  memcpy (index, SID_SONG_LENGTH_MAGIC, 8);
+  header[0] = BYTE_ORDER_MARK;
+  header[1] = n_slots;
+  header[2] = lengths->len;
+  header[3] = 0;
+  memcpy (index + 8, header, sizeof (header));
+  stamp[0] = st->st_mtime;
+  stamp[1] = st->st_size;
+  memcpy (index + 24, stamp, sizeof (stamp));
+
+  table = (Slot *) (index + SID_SONG_LENGTH_HEADER_SIZE);
+  for (i = 0; i < slots->len; i++) {
+    Slot *s = &g_array_index (slots, Slot, i);
+
+    for (h = slot_hash (s->md5) & (n_slots - 1); table[h].songs != 0;
+        h = (h + 1) & (n_slots - 1)) {
+      /* duplicates, the first one wins */
+      if (memcmp (table[h].md5, s->md5, 16) == 0)
+        break;
+    }
+    if (table[h].songs == 0)
+      table[h] = *s;
+  }
+
+  end = (gchar *) (table + n_slots);
+  memcpy (end, lengths->data, lengths->len * sizeof (guint32));
+
+  g_array_free (slots, TRUE);
+  g_array_free (lengths, TRUE);
+
+  return index;
+}
+
+/* checks @data is an index of the database described by @st and points
+ * @db at its tables */
+static gboolean
+use_index (SidSongLengthDb * db, const gchar * data, gsize size,
+    const GStatBuf * st)
+{
+  guint32 header[4];
+  guint64 stamp[2];
+
+  if (size < SID_SONG_LENGTH_HEADER_SIZE)
+    return FALSE;
+  if (memcmp (data, SID_SONG_LENGTH_MAGIC, 8) != 0)
+    return FALSE;
+  memcpy (header, data + 8, sizeof (header));
+  memcpy (stamp, data + 24, sizeof (stamp));
+  if (header[0] != BYTE_ORDER_MARK)
+    return FALSE;
+  if (stamp[0] != (guint64) st->st_mtime || stamp[1] != (guint64) st->st_size)
+    return FALSE;
+  if (header[1] == 0 || (header[1] & (header[1] - 1)) != 0)
+    return FALSE;
+  if (size != SID_SONG_LENGTH_HEADER_SIZE +
+      (gsize) header[1] * SID_SONG_LENGTH_SLOT_SIZE +
+      (gsize) header[2] * sizeof (guint32))
+    return FALSE;
+
+  db->slots = (const guint8 *) data + SID_SONG_LENGTH_HEADER_SIZE;
+  db->n_slots = header[1];
+  db->lengths = (const guint32 *) (db->slots +
+      (gsize) header[1] * SID_SONG_LENGTH_SLOT_SIZE);
+  db->n_lengths = header[2];
+
+  return TRUE;
+}
+
+static gchar *
+index_location (const gchar * location)
+{
+  gchar *sum, *name, *path;
+
+  sum = g_compute_checksum_for_data (G_CHECKSUM_MD5, (const guchar *) location,
+      strlen (location));
+  name = g_strdup_printf ("songlengths-%s.idx", sum);
+  path = g_build_filename (g_get_user_cache_dir (), "gstreamer-1.0",
+      "siddecfp", name, NULL);
+  g_free (name);
+  g_free (sum);
+
+  return path;
+}
+
+static gboolean
+load (SidSongLengthDb * db, GError ** error)
+{
+  GStatBuf st;
+  gchar *index_path, *dir, *text;
+  gsize size;
+
+  if (g_stat (db->location, &st) != 0) {
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+        "Could not open %s: %s", db->location, g_strerror (errno));
+    return FALSE;
+  }
+
+  /* an index compiled earlier */
+  index_path = index_location (db->location);
+  db->mapped = g_mapped_file_new (index_path, FALSE, NULL);
+  if (db->mapped != NULL) {
+    if (use_index (db, g_mapped_file_get_contents (db->mapped),
+            g_mapped_file_get_length (db->mapped), &st)) {
+      g_free (index_path);
+      return TRUE;
+    }
+    g_mapped_file_unref (db->mapped);
+    db->mapped = NULL;
+  }
+
+  if (!g_file_get_contents (db->location, &text, NULL, error)) {
+    g_free (index_path);
+    return FALSE;
+  }
+  db->compiled = compile (text, &st, &size);
+  g_free (text);
+  use_index (db, db->compiled, size, &st);
+
+  /* not being able to cache it only makes the next start slower */
+  dir = g_path_get_dirname (index_path);
+  if (g_mkdir_with_parents (dir, 0755) == 0 &&
+      g_file_set_contents (index_path, db->compiled, size, NULL)) {
+    db->mapped = g_mapped_file_new (index_path, FALSE, NULL);
+    if (db->mapped != NULL && use_index (db,
+            g_mapped_file_get_contents (db->mapped),
+            g_mapped_file_get_length (db->mapped), &st)) {
+      g_free (db->compiled);
+      db->compiled = NULL;
+    } else {
+      if (db->mapped != NULL)
+        g_mapped_file_unref (db->mapped);
+      db->mapped = NULL;
+      use_index (db, db->compiled, size, &st);
+    }
+  }
+  g_free (dir);
+  g_free (index_path);
+
+  return TRUE;
+}
+
+static void
+db_free (SidSongLengthDb * db)
+{
+  if (db->mapped != NULL)
+    g_mapped_file_unref (db->mapped);
+  g_free (db->compiled);
+  g_free (db->location);
+  g_free (db);
+}
+
+/* returns the database at @location, compiling its index if needed */
+SidSongLengthDb *
+sid_song_length_db_open (const gchar * location, GError ** error)
+{
+  SidSongLengthDb *db;
+
+  g_mutex_lock (&dbs_lock);
+  if (dbs == NULL)
+    dbs = g_hash_table_new (g_str_hash, g_str_equal);
+
+  db = (SidSongLengthDb *) g_hash_table_lookup (dbs, location);
+  if (db != NULL) {
+    db->ref_count++;
+    g_mutex_unlock (&dbs_lock);
+    return db;
+  }
+
+  /* compiling holds the lock, so a database is only compiled once */
+  db = g_new0 (SidSongLengthDb, 1);
+  db->location = g_strdup (location);
+  db->ref_count = 1;
+  if (!load (db, error)) {
+    g_mutex_unlock (&dbs_lock);
+    db_free (db);
+    return NULL;
+  }
+  g_hash_table_insert (dbs, db->location, db);
+  g_mutex_unlock (&dbs_lock);
+
+  return db;
+}
+
+SidSongLengthDb *
+sid_song_length_db_ref (SidSongLengthDb * db)
+{
+  g_mutex_lock (&dbs_lock);
+  db->ref_count++;
+  g_mutex_unlock (&dbs_lock);
+
+  return db;
+}
+
+void
+sid_song_length_db_unref (SidSongLengthDb * db)
+{
+  if (db == NULL)
+    return;
+
+  g_mutex_lock (&dbs_lock);
+  if (--db->ref_count > 0) {
+    g_mutex_unlock (&dbs_lock);
+    return;
+  }
+  g_hash_table_remove (dbs, db->location);
+  g_mutex_unlock (&dbs_lock);
+
+  db_free (db);
+}
+
+/* looks up the length of @song, counting from 1, of the tune with the MD5
+ * @md5 in hex */
+gboolean
+sid_song_length_db_lookup (SidSongLengthDb * db, const gchar * md5,
+    guint song, GstClockTime * length)
+{
+  guint8 key[16];
+  Slot slot;
+  guint32 h, i;
+
+  if (md5 == NULL || strlen (md5) < 32 || !parse_md5 (md5, key))
+    return FALSE;
+
+  /* an index written by us always has empty slots, but a damaged one may
+   * not, so probe every slot at most once */
+  h = slot_hash (key) & (db->n_slots - 1);
+  for (i = 0; i < db->n_slots; i++) {
+    memcpy (&slot, db->slots + h * SID_SONG_LENGTH_SLOT_SIZE, sizeof (slot));
+    if (slot.songs == 0)
+      return FALSE;
+    if (memcmp (slot.md5, key, 16) == 0)
+      break;
+    h = (h + 1) & (db->n_slots - 1);
+  }
+  if (i == db->n_slots)
+    return FALSE;
+
+  if (song < 1 || song > slot.songs || slot.first + song > db->n_lengths)
+    return FALSE;
+  if (db->lengths[slot.first + song - 1] == 0)
+    return FALSE;
+
+  *length = db->lengths[slot.first + song - 1] * GST_MSECOND;
+
+  return TRUE;
+}
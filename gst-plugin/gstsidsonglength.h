@@ -0,0 +1,69 @@
+/* GStreamer
+ * Copyright (C) <2022> Joni Valtanen <jvaltane@kapsi.fi>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef __GST_SIDSONGLENGTH_H__
+#define __GST_SIDSONGLENGTH_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Song lengths from the HVSC Songlengths.md5 database. The text file is
+ * compiled into a binary index once and cached in the user cache
+ * directory, later openings only map the index. All numbers are in host
+ * byte order as the index never leaves the machine:
+ *
+ *   header  "SIDLENS" 0x01     magic and version
+ *           guint32            0x01020304, byte order mark
+ *           guint32            number of slots, a power of two
+ *           guint32            number of lengths
+ *           guint32            reserved, zero
+ *           guint64            modification time of the database
+ *           guint64            size of the database
+ *
+ *   slot    guint8[16]         MD5 of the tune, empty slots are zero
+ *           guint32            index of the first length
+ *           guint32            number of songs
+ *
+ *   length  guint32            milliseconds, 0 when unknown
+ *
+ * Slots are an open addressing hash table keyed by the first four bytes of
+ * the MD5 with linear probing.
+ */
+
+#define SID_SONG_LENGTH_MAGIC       "SIDLENS\001"
+#define SID_SONG_LENGTH_HEADER_SIZE 40
+#define SID_SONG_LENGTH_SLOT_SIZE   24
+
+typedef struct _SidSongLengthDb SidSongLengthDb;
+
+SidSongLengthDb *sid_song_length_db_open   (const gchar * location,
+                                            GError ** error);
+SidSongLengthDb *sid_song_length_db_ref    (SidSongLengthDb * db);
+void             sid_song_length_db_unref  (SidSongLengthDb * db);
+
+gboolean         sid_song_length_db_lookup (SidSongLengthDb * db,
+                                            const gchar * md5, guint song,
+                                            GstClockTime * length);
+
+G_END_DECLS
+
+#endif /* __GST_SIDSONGLENGTH_H__ */
@@ -0,0 +1,167 @@
+/* GStreamer
+ * Copyright (C) <2022> Joni Valtanen <jvaltane@kapsi.fi>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstsidloop.h"
+
+/* the multiplier of the rolling hash in gstsidloop.cc */
+#define ROLL_BASE G_GUINT64_CONSTANT (0x9e3779b97f4a7c15)
+
+#define FRAME (20 * GST_MSECOND)
+
+/* Pushes @n states, the frame i ending at (@first + i + 1) * FRAME.
+ * Returns the index of the state a loop was found at, or -1. */
+static gint
+push_states (SidLoopDetector * detector, const guint64 * states, guint n,
+    guint first, GstClockTime * start, GstClockTime * period)
+{
+  guint i;
+
+  for (i = 0; i < n; i++) {
+    if (sid_loop_detector_push (detector, states[i], (first + i + 1) * FRAME,
+            start, period))
+      return (gint) i;
+  }
+
+  return -1;
+}
+
+/* The pattern 1..8 after some other states. Its first window recurs after
+ * one period, which is only noticed if the rolling hash dropped the states
+ * before the window correctly. */
+static void
+test_loop_found (void)
+{
+  const guint64 states[] = {
+    100, 200, 300,
+    1, 2, 3, 4, 5, 6, 7, 8,
+    1, 2, 3, 4, 5, 6, 7, 8,
+  };
+  SidLoopDetector *detector;
+  GstClockTime start, period;
+
+  detector = sid_loop_detector_new (4, 1);
+  sid_loop_detector_reset (detector, 0);
+
+  /* the window 1 2 3 4 ends with state 6 and again with state 14 */
+  g_assert_cmpint (push_states (detector, states, G_N_ELEMENTS (states), 0,
+          &start, &period), ==, 14);
+  g_assert_cmpuint (start, ==, 3 * FRAME);
+  g_assert_cmpuint (period, ==, 8 * FRAME);
+
+  sid_loop_detector_free (detector);
+}
+
+/* held notes repeat a state without the music looping */
+static void
+test_min_changes (void)
+{
+  const guint64 states[] = { 5, 5, 5, 5, 5, 5, 5, 5, 5, 5 };
+  SidLoopDetector *detector;
+  GstClockTime start, period;
+
+  detector = sid_loop_detector_new (4, 1);
+  sid_loop_detector_reset (detector, 0);
+  g_assert_cmpint (push_states (detector, states, G_N_ELEMENTS (states), 0,
+          &start, &period), ==, -1);
+  sid_loop_detector_free (detector);
+
+  /* without the minimum the second full window is a loop of one frame */
+  detector = sid_loop_detector_new (4, 0);
+  sid_loop_detector_reset (detector, 0);
+  g_assert_cmpint (push_states (detector, states, G_N_ELEMENTS (states), 0,
+          &start, &period), ==, 4);
+  g_assert_cmpuint (start, ==, 0);
+  g_assert_cmpuint (period, ==, FRAME);
+  sid_loop_detector_free (detector);
+}
+
+/* With a window of two, the windows (a, b) and (a + 1, b - ROLL_BASE) have
+ * the same hash. That is no loop, the window after it that really recurs
+ * is. */
+static void
+test_hash_collision (void)
+{
+  const guint64 states[] = { 1, 100, 2, 100 - ROLL_BASE, 1, 100 };
+  SidLoopDetector *detector;
+  GstClockTime start, period;
+
+  detector = sid_loop_detector_new (2, 0);
+  sid_loop_detector_reset (detector, 0);
+  g_assert_cmpint (push_states (detector, states, G_N_ELEMENTS (states), 0,
+          &start, &period), ==, 5);
+  g_assert_cmpuint (start, ==, 0);
+  g_assert_cmpuint (period, ==, 4 * FRAME);
+  sid_loop_detector_free (detector);
+}
+
+/* nothing seen before a reset counts after it */
+static void
+test_reset (void)
+{
+  const guint64 states[] = { 1, 2, 3, 4, 5, 6 };
+  SidLoopDetector *detector;
+  GstClockTime start, period;
+
+  detector = sid_loop_detector_new (3, 1);
+  sid_loop_detector_reset (detector, 0);
+  g_assert_cmpint (push_states (detector, states, G_N_ELEMENTS (states), 0,
+          &start, &period), ==, -1);
+
+  sid_loop_detector_reset (detector, 10 * FRAME);
+  g_assert_cmpint (push_states (detector, states, G_N_ELEMENTS (states), 10,
+          &start, &period), ==, -1);
+  g_assert_cmpint (push_states (detector, states, 3, 16, &start, &period),
+      ==, 2);
+  g_assert_cmpuint (start, ==, 10 * FRAME);
+  g_assert_cmpuint (period, ==, 6 * FRAME);
+
+  sid_loop_detector_free (detector);
+}
+
+/* the register hash can be built up in parts */
+static void
+test_hash_registers (void)
+{
+  const guint8 regs[] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55 };
+  guint64 whole, parts;
+
+  whole = sid_loop_hash_registers (0, regs, sizeof (regs));
+  parts = sid_loop_hash_registers (0, regs, 2);
+  parts = sid_loop_hash_registers (parts, regs + 2, sizeof (regs) - 2);
+  g_assert_cmpuint (whole, ==, parts);
+  g_assert_cmpuint (whole, !=, sid_loop_hash_registers (0, regs, 5));
+}
+
+int
+main (int argc, char **argv)
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/sidloop/loop-found", test_loop_found);
+  g_test_add_func ("/sidloop/min-changes", test_min_changes);
+  g_test_add_func ("/sidloop/hash-collision", test_hash_collision);
+  g_test_add_func ("/sidloop/reset", test_reset);
+  g_test_add_func ("/sidloop/hash-registers", test_hash_registers);
+
+  return g_test_run ();
+}
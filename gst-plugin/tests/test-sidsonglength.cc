@@ -0,0 +1,232 @@
+/* GStreamer
+ * Copyright (C) <2022> Joni Valtanen <jvaltane@kapsi.fi>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <utime.h>
+#include <glib/gstdio.h>
+
+#include "gstsidsonglength.h"
+
+/* Both tunes hash to the last of the 16 slots, so the second one wraps
+ * around to the first slot. Lengths are written in all forms found in
+ * HVSC releases. */
+#define MD5_A "0f000000000000000000000000000001"
+#define MD5_B "0f000000000000000000000000000002"
+#define MD5_MISSING "0f000000000000000000000000000003"
+
+static const gchar *database =
+    "[Database]\n"
+    "; /MUSICIANS/A/a.sid\n"
+    MD5_A "=1:23.456 0:05(G) 2:00.5 0:00\n"
+    "; /MUSICIANS/B/b.sid\n"
+    MD5_B "=0:10 1:02.03(M)\n";
+
+static gchar *
+database_location (void)
+{
+  gchar *dir = g_build_filename (g_get_user_data_dir (), "hvsc", NULL);
+  gchar *location;
+
+  g_assert_cmpint (g_mkdir_with_parents (dir, 0755), ==, 0);
+  location = g_build_filename (dir, "Songlengths.md5", NULL);
+  g_free (dir);
+
+  return location;
+}
+
+static void
+write_database (const gchar * location, const gchar * text)
+{
+  g_assert_true (g_file_set_contents (location, text, -1, NULL));
+}
+
+/* where gstsidsonglength.cc caches the index of @location */
+static gchar *
+index_location (const gchar * location)
+{
+  gchar *sum, *name, *path;
+
+  sum = g_compute_checksum_for_data (G_CHECKSUM_MD5, (const guchar *) location,
+      strlen (location));
+  name = g_strdup_printf ("songlengths-%s.idx", sum);
+  path = g_build_filename (g_get_user_cache_dir (), "gstreamer-1.0",
+      "siddecfp", name, NULL);
+  g_free (name);
+  g_free (sum);
+
+  return path;
+}
+
+static GstClockTime
+lookup (SidSongLengthDb * db, const gchar * md5, guint song)
+{
+  GstClockTime length;
+
+  if (!sid_song_length_db_lookup (db, md5, song, &length))
+    return GST_CLOCK_TIME_NONE;
+
+  return length;
+}
+
+static void
+test_lengths (void)
+{
+  gchar *location = database_location ();
+  SidSongLengthDb *db;
+
+  write_database (location, database);
+  db = sid_song_length_db_open (location, NULL);
+  g_assert_nonnull (db);
+
+  g_assert_cmpuint (lookup (db, MD5_A, 1), ==, 83456 * GST_MSECOND);
+  g_assert_cmpuint (lookup (db, MD5_A, 2), ==, 5 * GST_SECOND);
+  g_assert_cmpuint (lookup (db, MD5_A, 3), ==, 120500 * GST_MSECOND);
+  /* listed as 0:00, which means unknown */
+  g_assert_cmpuint (lookup (db, MD5_A, 4), ==, GST_CLOCK_TIME_NONE);
+  g_assert_cmpuint (lookup (db, MD5_A, 5), ==, GST_CLOCK_TIME_NONE);
+  g_assert_cmpuint (lookup (db, MD5_A, 0), ==, GST_CLOCK_TIME_NONE);
+
+  /* the second tune is in the first slot, after wrapping around */
+  g_assert_cmpuint (lookup (db, MD5_B, 1), ==, 10 * GST_SECOND);
+  g_assert_cmpuint (lookup (db, MD5_B, 2), ==, 62030 * GST_MSECOND);
+
+  g_assert_cmpuint (lookup (db, MD5_MISSING, 1), ==, GST_CLOCK_TIME_NONE);
+  g_assert_cmpuint (lookup (db, "not an md5", 1), ==, GST_CLOCK_TIME_NONE);
+
+  sid_song_length_db_unref (db);
+  g_free (location);
+}
+
+/* the index is cached and compiled again when the database changes */
+static void
+test_cache (void)
+{
+  gchar *location = database_location ();
+  gchar *index = index_location (location);
+  SidSongLengthDb *db, *again;
+  GStatBuf st;
+  struct utimbuf times;
+
+  write_database (location, MD5_A "=1:00\n");
+  db = sid_song_length_db_open (location, NULL);
+  g_assert_nonnull (db);
+  g_assert_true (g_file_test (index, G_FILE_TEST_EXISTS));
+  g_assert_cmpuint (lookup (db, MD5_A, 1), ==, 60 * GST_SECOND);
+
+  /* opened databases are shared */
+  again = sid_song_length_db_open (location, NULL);
+  g_assert_true (again == db);
+  sid_song_length_db_unref (again);
+  sid_song_length_db_unref (db);
+
+  /* another size */
+  write_database (location, MD5_A "=10:00\n");
+  db = sid_song_length_db_open (location, NULL);
+  g_assert_cmpuint (lookup (db, MD5_A, 1), ==, 600 * GST_SECOND);
+  sid_song_length_db_unref (db);
+
+  /* the same size, possibly within the same second, with a new mtime */
+  write_database (location, MD5_A "=20:00\n");
+  g_assert_cmpint (g_stat (location, &st), ==, 0);
+  times.actime = st.st_atime;
+  times.modtime = st.st_mtime + 10;
+  g_assert_cmpint (g_utime (location, &times), ==, 0);
+  db = sid_song_length_db_open (location, NULL);
+  g_assert_cmpuint (lookup (db, MD5_A, 1), ==, 1200 * GST_SECOND);
+  sid_song_length_db_unref (db);
+
+  g_free (index);
+  g_free (location);
+}
+
+/* An index with every slot taken, which the compiler never writes. A
+ * lookup of a tune that is not in it must still end. */
+static void
+test_full_index (void)
+{
+  gchar *location = database_location ();
+  gchar *index = index_location (location);
+  SidSongLengthDb *db;
+  gchar *dir, *data;
+  guint32 header[4], length = 1000;
+  guint64 stamp[2];
+  GStatBuf st;
+  gsize size;
+  guint i;
+
+  write_database (location, database);
+  g_assert_cmpint (g_stat (location, &st), ==, 0);
+
+  size = SID_SONG_LENGTH_HEADER_SIZE + 16 * SID_SONG_LENGTH_SLOT_SIZE +
+      16 * sizeof (guint32);
+  data = (gchar *) g_malloc0 (size);
+  memcpy (data, SID_SONG_LENGTH_MAGIC, 8);
+  header[0] = 0x01020304;
+  header[1] = 16;
+  header[2] = 16;
+  header[3] = 0;
+  memcpy (data + 8, header, sizeof (header));
+  stamp[0] = st.st_mtime;
+  stamp[1] = st.st_size;
+  memcpy (data + 24, stamp, sizeof (stamp));
+  for (i = 0; i < 16; i++) {
+    gchar *slot = data + SID_SONG_LENGTH_HEADER_SIZE +
+        i * SID_SONG_LENGTH_SLOT_SIZE;
+    guint32 first_songs[2] = { i, 1 };
+
+    slot[0] = (gchar) i;
+    slot[15] = 1;
+    memcpy (slot + 16, first_songs, sizeof (first_songs));
+    memcpy (data + SID_SONG_LENGTH_HEADER_SIZE +
+        16 * SID_SONG_LENGTH_SLOT_SIZE + i * sizeof (guint32), &length,
+        sizeof (length));
+  }
+
+  dir = g_path_get_dirname (index);
+  g_assert_cmpint (g_mkdir_with_parents (dir, 0755), ==, 0);
+  g_assert_true (g_file_set_contents (index, data, size, NULL));
+
+  db = sid_song_length_db_open (location, NULL);
+  g_assert_nonnull (db);
+  g_assert_cmpuint (lookup (db, "03000000000000000000000000000001", 1), ==,
+      GST_SECOND);
+  g_assert_cmpuint (lookup (db, MD5_MISSING, 1), ==, GST_CLOCK_TIME_NONE);
+  sid_song_length_db_unref (db);
+
+  g_free (dir);
+  g_free (data);
+  g_free (index);
+  g_free (location);
+}
+
+int
+main (int argc, char **argv)
+{
+  g_test_init (&argc, &argv, G_TEST_OPTION_ISOLATE_DIRS, NULL);
+
+  g_test_add_func ("/sidsonglength/lengths", test_lengths);
+  g_test_add_func ("/sidsonglength/cache", test_cache);
+  g_test_add_func ("/sidsonglength/full-index", test_full_index);
+
+  return g_test_run ();
+}